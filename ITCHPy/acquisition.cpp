@@ -0,0 +1,172 @@
+#include "acquisition.h"
+
+#include <cstddef>
+
+Acquisition::Acquisition(unsigned int capacity) :
+    capacity(capacity)
+{
+    for(unsigned int n = 0; n < 2; n++)
+    {
+        buffers[n] = allocate();
+        data[n] = reinterpret_cast<Record*>(np::ndarray(
+                        p::extract<np::ndarray>(buffers[n])).get_data());
+    }
+
+    // Also sees every frame of multi-sample reports
+    mouse.addCallback([this](const ITCHy::State& state){ store(state); });
+}
+
+Acquisition::~Acquisition()
+{
+    stop();
+}
+
+np::dtype Acquisition::dtype()
+{
+    p::list names;
+    p::list formats;
+    p::list offsets;
+
+    auto field = [&](const char* name, const char* format, size_t offset)
+    {
+        names.append(name);
+        formats.append(format);
+        offsets.append(offset);
+    };
+
+    field("position",        "2<f4", offsetof(Record, state) + offsetof(ITCHy::State, position));
+    field("angle",           "<f4",  offsetof(Record, state) + offsetof(ITCHy::State, angle));
+    field("velocity",        "2<f4", offsetof(Record, state) + offsetof(ITCHy::State, velocity));
+    field("angularVelocity", "<f4",  offsetof(Record, state) + offsetof(ITCHy::State, angularVelocity));
+    field("button",          "u1",   offsetof(Record, state) + offsetof(ITCHy::State, button));
+    field("sequence",        "u1",   offsetof(Record, state) + offsetof(ITCHy::State, sequence));
+    field("version",         "u1",   offsetof(Record, state) + offsetof(ITCHy::State, version));
+    field("checksum",        "u1",   offsetof(Record, state) + offsetof(ITCHy::State, checksum));
+    field("leftSensor",      "2<f4", offsetof(Record, state) + offsetof(ITCHy::State, leftSensor));
+    field("rightSensor",     "2<f4", offsetof(Record, state) + offsetof(ITCHy::State, rightSensor));
+    field("leftIncrement",   "2<i2", offsetof(Record, state) + offsetof(ITCHy::State, leftIncrement));
+    field("rightIncrement",  "2<i2", offsetof(Record, state) + offsetof(ITCHy::State, rightIncrement));
+    field("timeStep",        "<f4",  offsetof(Record, state) + offsetof(ITCHy::State, timeStep));
+    field("time",            "<f4",  offsetof(Record, state) + offsetof(ITCHy::State, time));
+    field("deviceTime",      "<u4",  offsetof(Record, state) + offsetof(ITCHy::State, deviceTime));
+    field("hostTime",        "<u8",  offsetof(Record, state) + offsetof(ITCHy::State, hostTime));
+    field("sampleTime",      "<u8",  offsetof(Record, sampleTime));
+
+    p::dict description;
+    description["names"] = names;
+    description["formats"] = formats;
+    description["offsets"] = offsets;
+    description["itemsize"] = sizeof(Record);
+
+    return np::dtype(description);
+}
+
+p::object Acquisition::allocate()
+{
+    return np::zeros(p::make_tuple(capacity), dtype());
+}
+
+bool Acquisition::start()
+{
+    if(active)
+    {
+        return true;
+    }
+
+    if(!mouse.connect(1000))
+    {
+        return false;
+    }
+
+    active = true;
+    thread = std::thread([this](){ run(); });
+    return true;
+}
+
+void Acquisition::stop()
+{
+    active = false;
+    if(thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+bool Acquisition::running() const
+{
+    return active;
+}
+
+bool Acquisition::setMultiSample(bool enabled)
+{
+    return mouse.setReportFormat(enabled ? ITCHy::ReportFormat::MultiSample :
+                                           ITCHy::ReportFormat::Snapshot);
+}
+
+void Acquisition::run()
+{
+    while(active)
+    {
+        if(!mouse.connected())
+        {
+            mouse.connect(100);
+            continue;
+        }
+
+        mouse.currentState(100);
+    }
+}
+
+void Acquisition::store(const ITCHy::State& state)
+{
+    uint64_t sampleTime = state.deviceTime ? mouse.hostTime(state.deviceTime) : 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(count < capacity)
+    {
+        Record& record = data[current][count++];
+        record.state = state;
+        record.sampleTime = sampleTime ? sampleTime : state.hostTime;
+    }
+    else
+    {
+        droppedFrames++;
+    }
+}
+
+p::object Acquisition::frames()
+{
+    unsigned int filled;
+    size_t n;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        filled = current;
+        n = count;
+
+        // Python may still hold a view of the array that is about to be
+        // refilled, replace it in that case
+        unsigned int next = 1 - current;
+        if(Py_REFCNT(buffers[next].ptr()) > 1)
+        {
+            buffers[next] = allocate();
+            data[next] = reinterpret_cast<Record*>(np::ndarray(
+                            p::extract<np::ndarray>(buffers[next])).get_data());
+        }
+
+        current = next;
+        count = 0;
+    }
+
+    return buffers[filled].slice(0, n);
+}
+
+uint64_t Acquisition::dropped() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return droppedFrames;
+}
+
+ITCHy::Statistics Acquisition::statistics() const
+{
+    return mouse.statistics();
+}
@@ -0,0 +1,73 @@
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include "itchpy.h"
+
+#include <boost/python/numpy.hpp>
+#include <itchy/itchy.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace np = boost::python::numpy;
+
+// Captures every frame of the device from a C++ thread into preallocated
+// NumPy structured arrays. Two arrays are used alternately: while Python
+// works on the frames returned by frames(), the thread fills the other one.
+class Acquisition
+{
+public:
+    // Layout of one array element
+    struct Record
+    {
+        ITCHy::State state;
+        uint64_t sampleTime;    // Device time mapped to host time [ns]
+    };
+
+    explicit Acquisition(unsigned int capacity = 8192);
+    ~Acquisition();
+
+    Acquisition(const Acquisition&) = delete;
+    Acquisition& operator=(const Acquisition&) = delete;
+
+    bool start();
+    void stop();
+    bool running() const;
+
+    // Several frames per USB report, see ITCHy::setReportFormat()
+    bool setMultiSample(bool enabled);
+
+    // Frames captured since the last call as a view into the internal
+    // array (no copy). If the view is still referenced by the next call,
+    // a new array is allocated instead of reusing it.
+    p::object frames();
+
+    // Frames lost because frames() has not been called in time
+    uint64_t dropped() const;
+
+    ITCHy::Statistics statistics() const;
+
+    static np::dtype dtype();
+
+private:
+    p::object allocate();
+    void run();
+    void store(const ITCHy::State& state);
+
+    unsigned int capacity;
+    ITCHy mouse;
+
+    std::thread thread;
+    std::atomic<bool> active{false};
+
+    // Guards the buffer currently filled by the thread
+    mutable std::mutex mutex;
+    p::object buffers[2];
+    Record* data[2] = {nullptr, nullptr};
+    unsigned int current = 0;
+    size_t count = 0;
+    uint64_t droppedFrames = 0;
+};
+
+#endif // ACQUISITION_H
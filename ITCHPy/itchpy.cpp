@@ -1,7 +1,10 @@
 #include "itchpy.h"
+#include "acquisition.h"
 
 #include <itchy/tactilemousequery.h>
 
+#include <chrono>
+
 p::str showQVector2D(QVector2D const& v) {
     p::str res = "<";
     res += p::object(v).attr("__class__").attr("__name__");
@@ -9,8 +12,105 @@ p::str showQVector2D(QVector2D const& v) {
     return res;
 }
 
+// Blocking calls run without the GIL
+
+void update(TactileMouseQuery& query)
+{
+    ReleaseGIL release;
+    query.update();
+}
+
+bool initialize(TactileMouseQuery& query)
+{
+    ReleaseGIL release;
+    return query.initialize();
+}
+
+bool waitForUpdate(TactileMouseQuery& query, double timeout)
+{
+    ReleaseGIL release;
+    auto duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(timeout));
+    return query.waitForUpdate(std::chrono::steady_clock::now() + duration);
+}
+
+bool start(Acquisition& acquisition)
+{
+    ReleaseGIL release;
+    return acquisition.start();
+}
+
+void stop(Acquisition& acquisition)
+{
+    ReleaseGIL release;
+    acquisition.stop();
+}
+
+bool setMultiSample(Acquisition& acquisition, bool enabled)
+{
+    ReleaseGIL release;
+    return acquisition.setMultiSample(enabled);
+}
+
+p::dict toDict(const ITCHy::Statistics& statistics)
+{
+    p::list intervals;
+    p::list latencies;
+    for(size_t n = 0; n < ITCHy::Statistics::HistogramBins; n++)
+    {
+        intervals.append(statistics.intervalHistogram[n]);
+        latencies.append(statistics.latencyHistogram[n]);
+    }
+
+    p::dict result;
+    result["framesReceived"] = statistics.framesReceived;
+    result["framesLost"] = statistics.framesLost;
+    result["reportsLost"] = statistics.reportsLost;
+    result["framesCorrupted"] = statistics.framesCorrupted;
+    result["receiveErrors"] = statistics.receiveErrors;
+    result["sendFailures"] = statistics.sendFailures;
+    result["reconnects"] = statistics.reconnects;
+    result["intervalHistogram"] = intervals;
+    result["latencyHistogram"] = latencies;
+    return result;
+}
+
+p::dict queryStatistics(const TactileMouseQuery& query)
+{
+    return toDict(query.statistics());
+}
+
+p::dict acquisitionStatistics(const Acquisition& acquisition)
+{
+    return toDict(acquisition.statistics());
+}
+
+// Awaits a new frame without blocking the event loop: detached queries are
+// woken through their descriptor, attached ones update in an executor.
+const char* nextState = R"(
+import asyncio
+
+async def next_state(self, timeout=None):
+    loop = asyncio.get_event_loop()
+    descriptor = self.descriptor()
+    if descriptor < 0:
+        await asyncio.wait_for(loop.run_in_executor(None, self.update), timeout)
+        return self
+
+    ready = loop.create_future()
+    loop.add_reader(descriptor, lambda: ready.done() or ready.set_result(None))
+    try:
+        await asyncio.wait_for(ready, timeout)
+    finally:
+        loop.remove_reader(descriptor)
+    self.update()
+    return self
+)";
+
 BOOST_PYTHON_MODULE(ITCHPy)
 {
+    np::initialize();
+
     p::class_<QVector2D>("QVector2D")
             .def(p::init<double, double>())
             .add_property("x", &QVector2D::x, &QVector2D::setX)
@@ -25,7 +125,25 @@ BOOST_PYTHON_MODULE(ITCHPy)
             .def("orientation", &TactileMouseQuery::orientation)
             .def("angularVelocity", &TactileMouseQuery::angularVelocity)
             .def("buttonPressed", &TactileMouseQuery::buttonPressed)
-            .def("update", &TactileMouseQuery::update)
-            .def("initialize", &TactileMouseQuery::initialize)
-            .def("feedback", &TactileMouseQuery::feedback);
+            .def("update", &update)
+            .def("initialize", &initialize)
+            .def("feedback", &TactileMouseQuery::feedback)
+            .def("waitForUpdate", &waitForUpdate)
+            .def("descriptor", &TactileMouseQuery::descriptor)
+            .def("statistics", &queryStatistics);
+
+    p::object scope = p::scope();
+    p::exec(nextState, scope.attr("__dict__"));
+    scope.attr("TactileMouseQuery").attr("next_state") = scope.attr("next_state");
+    p::delattr(scope, "next_state");
+
+    p::class_<Acquisition, boost::noncopyable>("Acquisition", p::init<p::optional<unsigned int>>())
+            .def("start", &start)
+            .def("stop", &stop)
+            .def("running", &Acquisition::running)
+            .def("setMultiSample", &setMultiSample)
+            .def("frames", &Acquisition::frames)
+            .def("dropped", &Acquisition::dropped)
+            .def("statistics", &acquisitionStatistics)
+            .add_static_property("dtype", &Acquisition::dtype);
 }
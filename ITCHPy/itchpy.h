@@ -4,4 +4,19 @@
 #include <boost/python.hpp>
 namespace p = boost::python;
 
+// Releases the GIL for the lifetime of the object, so other Python threads
+// keep running while C++ code blocks. No Python API calls in between!
+class ReleaseGIL
+{
+public:
+    ReleaseGIL() : state(PyEval_SaveThread()) {}
+    ~ReleaseGIL() { PyEval_RestoreThread(state); }
+
+    ReleaseGIL(const ReleaseGIL&) = delete;
+    ReleaseGIL& operator=(const ReleaseGIL&) = delete;
+
+private:
+    PyThreadState* state;
+};
+
 #endif // SCRATCHPY_H
@@ -0,0 +1,44 @@
+#-------------------------------------------------
+#
+# Offline benchmarks for libITCHy
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = ITCHyBenchmark
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+# Use this option if libITCHy was built without the libSCRATCHy compatible
+# interface, this skips the TactileMouseQuery benchmarks
+#CONFIG   += noscratchy
+
+SOURCES += main.cpp \
+        firmware.cpp \
+        microbenchmark.cpp \
+        prediction.cpp \
+        replay.cpp \
+        trace.cpp
+
+HEADERS  += firmware.h \
+        microbenchmark.h \
+        prediction.h \
+        replay.h \
+        trace.h
+
+# The microbenchmarks use private headers of libITCHy, the firmware
+# benchmark the simulation core of the firmware
+INCLUDEPATH += ../libITCHy ../teensyHIDSimulator/src
+
+LIBS += -lITCHy -lusb -lpthread
+
+!noscratchy {
+    QT      += gui
+}
+
+noscratchy {
+    DEFINES += ITCHY_NOSCRATCHY
+}
@@ -0,0 +1,695 @@
+#include "firmware.h"
+
+#include <simulationcore.h>
+#include <simulationfixed.h>
+#include <fastmath.h>
+#include <adns9800.h>
+#include <itchy/protocol.h>
+#include <itchy/simulation.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <functional>
+#include <vector>
+
+namespace
+{
+
+const float TimeStep = 0.0002f;         // Loop period of the firmware [s]
+const unsigned int Period = 5000;       // Steps per circle
+const unsigned int LiftInterval = 50000;
+
+// Operations too short for the clock resolution are timed in batches
+const unsigned int Batch = 256;
+
+uint64_t now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return uint64_t(time.tv_sec) * 1000000000ull + uint64_t(time.tv_nsec);
+}
+
+// Sensor increments [m] of a hand circling at 1 Hz while slowly turning
+void increments(unsigned int step, vec2f& left, vec2f& right)
+{
+    float t = step * TimeStep;
+    float speed = 0.1f * TimeStep;
+    float turn = 0.02f * TimeStep * std::sin(0.3f * t);
+    left = {{speed * std::cos(6.2831853f * t) - turn, speed * std::sin(6.2831853f * t)}};
+    right = {{speed * std::cos(6.2831853f * t) + turn, speed * std::sin(6.2831853f * t)}};
+}
+
+SimulationParameters parameters()
+{
+    SimulationParameters parameters;
+    parameters.mass = 0.1f;
+    parameters.stiffness = 2000.0f;
+    parameters.damping = 30.0f;
+    parameters.updateRate = 1;
+    return parameters;
+}
+
+// Sensor counts of the increments, the remainders are carried over
+struct Counts
+{
+    float carry[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    void next(unsigned int step, vec2s& left, vec2s& right)
+    {
+        vec2f l, r;
+        increments(step, l, r);
+        float target[4] = {l[0] / Scale[0], l[1] / Scale[1], r[0] / Scale[0], r[1] / Scale[1]};
+        int16_t counts[4];
+        for(int i = 0; i < 4; i++)
+        {
+            carry[i] += target[i];
+            counts[i] = int16_t(std::lround(carry[i]));
+            carry[i] -= counts[i];
+        }
+        left = {{counts[0], counts[1]}};
+        right = {{counts[2], counts[3]}};
+    }
+
+    static const vec2f Scale;
+};
+
+// Typical calibration: 8200 cpi with a slight skew
+const vec2f Counts::Scale = {{3.1e-6f, 3.2e-6f}};
+const mat2f Correction = {{0.9987503f, -0.0499792f, 0.0499792f, 0.9987503f}};
+
+// Times step(index) in batches and prints the distribution, result() keeps
+// the work from being optimized away
+template<typename Step, typename Result>
+void timing(const char* name, unsigned int steps, Step step, Result result, std::ostream& out)
+{
+    std::vector<double> samples;
+    samples.reserve(steps / Batch);
+    for(unsigned int n = 0; n < steps / Batch; n++)
+    {
+        uint64_t start = now();
+        for(unsigned int b = 0; b < Batch; b++)
+        {
+            step((n * Batch + b) % Period);
+        }
+        samples.push_back(double(now() - start) / Batch);
+    }
+
+    double sum = 0.0;
+    for(double sample : samples)
+    {
+        sum += sample;
+    }
+    double mean = samples.empty() ? 0.0 : sum / samples.size();
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p)
+    {
+        return samples.empty() ? 0.0 : samples[std::min(samples.size() - 1, size_t(p * samples.size()))];
+    };
+
+    out << "{\"benchmark\": \"" << name << "\""
+        << ", \"iterations\": " << samples.size() * Batch
+        << ", \"ns_per_op\": " << mean
+        << ", \"steps_per_second\": " << (mean > 0.0 ? 1e9 / mean : 0.0)
+        << ", \"p50\": " << percentile(0.50)
+        << ", \"p90\": " << percentile(0.90)
+        << ", \"p99\": " << percentile(0.99)
+        << ", \"max\": " << (samples.empty() ? 0.0 : samples.back())
+        << ", \"x\": " << result() << "}" << std::endl;
+}
+
+void timing(unsigned int steps, std::ostream& out)
+{
+    SimulationParameters params = parameters();
+    SimulationState sim;
+    sim.inverseMass = 1.0f / params.mass;
+    SimulationCore::reset(sim);
+    sim.dt = TimeStep;
+
+    // Precomputed, so only the simulation is timed
+    std::vector<vec2s> leftCounts(Period);
+    std::vector<vec2s> rightCounts(Period);
+    Counts counts;
+    for(unsigned int n = 0; n < Period; n++)
+    {
+        counts.next(n, leftCounts[n], rightCounts[n]);
+    }
+
+    std::vector<vec2f> left(Period);
+    std::vector<vec2f> right(Period);
+    for(unsigned int n = 0; n < Period; n++)
+    {
+        left[n] = SimulationCore::calibrate(Counts::Scale, Correction, leftCounts[n][0], leftCounts[n][1]);
+        right[n] = SimulationCore::calibrate(Counts::Scale, Correction, rightCounts[n][0], rightCounts[n][1]);
+    }
+
+    timing("firmware_step", steps, [&](unsigned int index)
+    {
+        SimulationCore::step(sim, params, left[index], right[index]);
+    }, [&sim]() { return sim.position[0]; }, out);
+
+    SimulationFixed::Parameters fixedParams = SimulationFixed::parameters(params);
+    SimulationFixed::Calibration calibration = SimulationFixed::calibration(Counts::Scale, Correction);
+    SimulationFixed::State fixed;
+    SimulationFixed::reset(fixed);
+    SimulationFixed::advance(fixed, uint32_t(TimeStep * 1.0e6f + 0.5f));
+
+    // Includes the calibration, which the fixed point build does per step
+    timing("firmware_fixed_step", steps, [&](unsigned int index)
+    {
+        SimulationFixed::step(fixed, fixedParams,
+                              SimulationFixed::calibrate(calibration, leftCounts[index][0], leftCounts[index][1]),
+                              SimulationFixed::calibrate(calibration, rightCounts[index][0], rightCounts[index][1]));
+    }, [&fixed]() { return fixed.point[0].toFloat(); }, out);
+}
+
+// Error bounds stated in fastmath.h
+const double MaxAtan2Error = 3.2e-7;           // [rad]
+const double MaxSincosError = 1.6e-7;
+const double MaxInverseSqrtError = 1.4e-7;     // Relative
+
+// FastMath against libm in double precision, and the time per call of both.
+// False if an error exceeds its bound.
+bool approximations(std::ostream& out)
+{
+    const unsigned int Samples = 1000000;
+
+    std::vector<float> x(Samples);
+    std::vector<float> y(Samples);
+    std::vector<float> angles(Samples);
+    std::vector<float> values(Samples);
+    for(unsigned int n = 0; n < Samples; n++)
+    {
+        // Full circle at lengths around the sensor distance, angles over
+        // the range of the simulation and values within 1% of the guess
+        double phi = -M_PI + 2.0 * M_PI * n / Samples;
+        double radius = 0.0756 * (0.5 + double(n % 1000) / 1000.0);
+        x[n] = float(radius * std::cos(phi));
+        y[n] = float(radius * std::sin(phi));
+        angles[n] = float(-1.6 * M_PI + 3.2 * M_PI * n / Samples);
+        values[n] = float(0.99 + 0.02 * (n % 997) / 997.0);
+    }
+
+    double atanError = 0.0;
+    double sincosError = 0.0;
+    double sqrtError = 0.0;
+    for(unsigned int n = 0; n < Samples; n++)
+    {
+        double reference = std::atan2(double(y[n]), double(x[n]));
+        double error = std::fabs(FastMath::atan2(y[n], x[n]) - reference);
+        atanError = std::max(atanError, std::min(error, 2.0 * M_PI - error));
+
+        float c, s;
+        FastMath::sincos(angles[n], c, s);
+        sincosError = std::max(sincosError, std::max(std::fabs(c - std::cos(double(angles[n]))),
+                                                     std::fabs(s - std::sin(double(angles[n])))));
+
+        double inverse = 1.0 / std::sqrt(double(values[n]));
+        sqrtError = std::max(sqrtError, std::fabs(FastMath::inverseSqrt(values[n], 1.0f) - inverse) / inverse);
+    }
+
+    auto perCall = [&](const std::function<float(unsigned int)>& function)
+    {
+        float sum = 0.0f;
+        uint64_t start = now();
+        for(unsigned int n = 0; n < Samples; n++)
+        {
+            sum += function(n);
+        }
+        volatile float sink = sum;
+        (void)sink;
+        return double(now() - start) / Samples;
+    };
+
+    out << "{\"benchmark\": \"firmware_approximations\""
+        << ", \"samples\": " << Samples
+        << ", \"max_atan2_error_rad\": " << atanError
+        << ", \"max_sincos_error\": " << sincosError
+        << ", \"max_inverse_sqrt_relative_error\": " << sqrtError
+        << ", \"libm_atan2_ns\": " << perCall([&](unsigned int n) { return std::atan2(y[n], x[n]); })
+        << ", \"fast_atan2_ns\": " << perCall([&](unsigned int n) { return FastMath::atan2(y[n], x[n]); })
+        << ", \"libm_sincos_ns\": " << perCall([&](unsigned int n) { return std::cos(angles[n]) + std::sin(angles[n]); })
+        << ", \"fast_sincos_ns\": " << perCall([&](unsigned int n)
+           {
+               float c, s;
+               FastMath::sincos(angles[n], c, s);
+               return c + s;
+           });
+
+    bool passed = atanError <= MaxAtan2Error && sincosError <= MaxSincosError &&
+                  sqrtError <= MaxInverseSqrtError;
+    out << ", \"passed\": " << (passed ? "true" : "false") << "}" << std::endl;
+    return passed;
+}
+
+// Largest deviations of the fixed point simulation accepted over 200 s.
+// Measured: 4.8e-9 m, 1.12 mm, 5.8 mm/s and 0.21 mrad.
+const float MaxCalibrationError = 1e-8f;    // [m]
+const float MaxPositionError = 1.5e-3f;     // [m]
+const float MaxVelocityError = 1e-2f;       // [m/s]
+const float MaxAngleError = 5e-4f;          // [rad]
+
+// The fixed point simulation against the float one, fed the same counts.
+// False if a deviation exceeds its bound.
+bool equivalence(unsigned int steps, std::ostream& out)
+{
+    SimulationParameters params = parameters();
+    SimulationState sim;
+    sim.inverseMass = 1.0f / params.mass;
+    SimulationCore::reset(sim);
+
+    SimulationFixed::Parameters fixedParams = SimulationFixed::parameters(params);
+    SimulationFixed::Calibration calibration = SimulationFixed::calibration(Counts::Scale, Correction);
+    SimulationFixed::State fixed;
+    SimulationFixed::reset(fixed);
+
+    SimulationState published;
+    Counts counts;
+    float calibrationError = 0.0f;
+    float positionError = 0.0f;
+    float velocityError = 0.0f;
+    float angleError = 0.0f;
+    for(unsigned int n = 0; n < steps; n++)
+    {
+        // Jitter the loop period like the firmware does
+        uint32_t microseconds = 190 + (n * 7) % 21;
+        SimulationCore::advance(sim, microseconds);
+        SimulationFixed::advance(fixed, microseconds);
+
+        vec2s left, right;
+        counts.next(n, left, right);
+        vec2f deltaLeft = SimulationCore::calibrate(Counts::Scale, Correction, left[0], left[1]);
+        vec2f deltaRight = SimulationCore::calibrate(Counts::Scale, Correction, right[0], right[1]);
+        SimulationFixed::Vector fixedLeft = SimulationFixed::calibrate(calibration, left[0], left[1]);
+        SimulationFixed::Vector fixedRight = SimulationFixed::calibrate(calibration, right[0], right[1]);
+
+        calibrationError = std::max(calibrationError,
+                                    std::max(len(sub(SimulationFixed::toFloat(fixedLeft), deltaLeft)),
+                                             len(sub(SimulationFixed::toFloat(fixedRight), deltaRight))));
+
+        SimulationCore::step(sim, params, deltaLeft, deltaRight);
+        SimulationFixed::step(fixed, fixedParams, fixedLeft, fixedRight);
+        if(n % LiftInterval == LiftInterval - 1)
+        {
+            SimulationCore::resetRotation(sim);
+            SimulationFixed::resetRotation(fixed);
+        }
+
+        SimulationFixed::publish(fixed, published);
+        positionError = std::max(positionError, len(sub(published.position, sim.position)));
+        velocityError = std::max(velocityError, len(sub(published.velocity, sim.velocity)));
+        float angle = std::fabs(published.angle - sim.angle);
+        angleError = std::max(angleError, std::min(angle, std::fabs(angle - 1.5f * float(M_PI))));
+    }
+
+    out << "{\"benchmark\": \"firmware_fixed_equivalence\""
+        << ", \"steps\": " << steps
+        << ", \"max_calibration_error_m\": " << calibrationError
+        << ", \"max_position_error_m\": " << positionError
+        << ", \"max_velocity_error_m_s\": " << velocityError
+        << ", \"max_angle_error_rad\": " << angleError;
+
+    bool passed = calibrationError <= MaxCalibrationError && positionError <= MaxPositionError &&
+                  velocityError <= MaxVelocityError && angleError <= MaxAngleError;
+    out << ", \"passed\": " << (passed ? "true" : "false") << "}" << std::endl;
+    return passed;
+}
+
+void regression(unsigned int steps, std::ostream& out)
+{
+    SimulationParameters params = parameters();
+    SimulationState sim;
+    sim.inverseMass = 1.0f / params.mass;
+    SimulationCore::reset(sim);
+    sim.dt = TimeStep;
+
+    Simulation host(Simulation::Integrator::VelocityVerlet);
+    host.addVariant({params.mass, params.stiffness, params.damping});
+
+    float positionError = 0.0f;
+    float angleError = 0.0f;
+    float rotationError = 0.0f;
+    float normError = 0.0f;
+    for(unsigned int n = 0; n < steps; n++)
+    {
+        ITCHy::State report = ITCHy::State();
+        increments(n, report.leftSensor, report.rightSensor);
+        report.timeStep = TimeStep;
+
+        SimulationCore::step(sim, params, report.leftSensor, report.rightSensor);
+        if(n % LiftInterval == LiftInterval - 1)
+        {
+            SimulationCore::resetRotation(sim);
+            report.button = ITCHyProtocol::RawLifted;
+        }
+
+        ITCHyProtocol::seal(reinterpret_cast<char*>(&report), uint8_t(n),
+                            ITCHyProtocol::RawIncrements);
+        host.update(report);
+
+        ITCHy::State state = host.state(0);
+        positionError = std::max(positionError,
+                                 std::hypot(state.position[0] - sim.position[0],
+                                            state.position[1] - sim.position[1]));
+        // The angle wraps within 1.5 pi
+        float angle = std::fabs(state.angle - sim.angle);
+        angleError = std::max(angleError, std::min(angle, std::fabs(angle - 1.5f * float(M_PI))));
+
+        // The incrementally updated rotation against the angle
+        double c = sim.rotation[0];
+        double s = sim.rotation[2];
+        rotationError = std::max(rotationError, float(std::fabs(std::atan2(
+                std::sin(sim.angle) * c - std::cos(sim.angle) * s,
+                std::cos(sim.angle) * c + std::sin(sim.angle) * s))));
+        normError = std::max(normError, float(std::fabs(std::sqrt(c * c + s * s) - 1.0)));
+    }
+
+    out << "{\"benchmark\": \"firmware_regression\""
+        << ", \"steps\": " << steps
+        << ", \"max_position_error_m\": " << positionError
+        << ", \"max_angle_error_rad\": " << angleError
+        << ", \"max_rotation_error_rad\": " << rotationError
+        << ", \"max_rotation_norm_error\": " << normError << "}" << std::endl;
+}
+
+// SPI timing stand-in for SpiScheduler: a virtual clock advanced by the
+// transfers (1 us per byte) and waits, checking the gaps of the ADNS-9800
+// datasheet and that several chips are only selected for writes. Reads
+// return response.
+class VirtualSpi
+{
+public:
+    static const int Chips = 2;
+
+    uint32_t micros() const
+    {
+        return uint32_t(clock / 1000);
+    }
+
+    void wait(uint32_t microseconds)
+    {
+        clock += uint64_t(microseconds) * 1000;
+    }
+
+    void select(uint8_t pin, bool selected)
+    {
+        Chip& chip = chips[pin];
+        if(selected == chip.selected)
+        {
+            return;
+        }
+
+        if(selected)
+        {
+            violations += (chip.deselectedAt && clock < chip.deselectedAt + chip.gap) ? 1 : 0;
+            chip.bytes = 0;
+            chip.selectedAt = clock;
+            if(firstSelect[pin] == 0)
+            {
+                firstSelect[pin] = clock;
+            }
+        }
+        else
+        {
+            chip.deselectedAt = clock;
+        }
+        chip.selected = selected;
+    }
+
+    uint8_t transfer(uint8_t value)
+    {
+        int selected = 0;
+        for(int pin = 0; pin < Chips; pin++)
+        {
+            selected += chips[pin].selected ? 1 : 0;
+        }
+
+        for(int pin = 0; pin < Chips; pin++)
+        {
+            Chip& chip = chips[pin];
+            if(!chip.selected)
+            {
+                continue;
+            }
+
+            if(chip.bytes == 0)
+            {
+                // Address byte: sets the wait before data and the gap after
+                // NCS is raised
+                chip.write = value & 0x80;
+                chip.burst = value == 0x50;
+                chip.gap = 1000ull * (chip.write ? SpiTiming::AfterWrite :
+                                      chip.burst ? SpiTiming::AfterBurst : SpiTiming::AfterRead);
+                chip.upload = value == (REG_SROM_Load_Burst | 0x80);
+                chip.addressAt = clock + ByteTime;
+            }
+            else if(chip.bytes == 1 && !chip.write)
+            {
+                uint64_t wait = 1000ull * (chip.burst ? SpiTiming::BurstAddress : SpiTiming::ReadAddress);
+                violations += clock < chip.addressAt + wait ? 1 : 0;
+            }
+            else if(chip.upload)
+            {
+                violations += clock < chip.addressAt + 1000ull * ADNS9800::SromByteTime ? 1 : 0;
+            }
+            violations += (selected > 1 && !chip.write) ? 1 : 0;
+            chip.addressAt = clock + ByteTime;
+            chip.bytes++;
+        }
+        clock += ByteTime;
+        return response;
+    }
+
+    // Time since start and between the first selection of the chips [us]
+    double elapsed(uint64_t start) const
+    {
+        return double(clock - start) / 1000.0;
+    }
+
+    double skew() const
+    {
+        return std::fabs(double(firstSelect[1]) - double(firstSelect[0])) / 1000.0;
+    }
+
+    void restart()
+    {
+        firstSelect[0] = 0;
+        firstSelect[1] = 0;
+    }
+
+    uint64_t clock = 1000000;
+    unsigned int violations = 0;
+    uint8_t response = 0;
+
+private:
+    static const uint64_t ByteTime = 1000;
+
+    struct Chip
+    {
+        bool selected = false;
+        bool write = false;
+        bool burst = false;
+        bool upload = false;
+        unsigned int bytes = 0;
+        uint64_t selectedAt = 0;
+        uint64_t addressAt = 0;
+        uint64_t deselectedAt = 0;
+        uint64_t gap = 0;
+    };
+
+    Chip chips[Chips];
+    uint64_t firstSelect[Chips] = {0, 0};
+};
+
+// One sensor after the other waiting out every gap, as the firmware did,
+// against SpiScheduler::run()
+void spiSchedule(std::ostream& out)
+{
+    struct Access
+    {
+        enum Type
+        {
+            Read,
+            Write,
+            Burst
+        } type;
+        uint8_t address;
+    };
+
+    struct Scenario
+    {
+        const char* name;
+        std::vector<Access> accesses;
+    };
+
+    const Scenario scenarios[] = {
+        {"register_reads", {{Access::Read, 0x02}, {Access::Read, 0x07}, {Access::Read, 0x03},
+                            {Access::Read, 0x04}, {Access::Read, 0x05}, {Access::Read, 0x06}}},
+        {"motion_burst", {{Access::Burst, 0x50}}},
+        {"configuration", {{Access::Read, 0x20}, {Access::Write, 0x20}, {Access::Write, 0x0f}}}
+    };
+
+    for(const Scenario& scenario : scenarios)
+    {
+        VirtualSpi bus;
+        SpiScheduler<VirtualSpi> spi(bus);
+        spi.addChip(0);
+        spi.addChip(1);
+        uint8_t data[14];
+
+        // Sequential, each access followed by its gap
+        uint64_t start = bus.clock;
+        for(int chip = 0; chip < 2; chip++)
+        {
+            for(const Access& access : scenario.accesses)
+            {
+                switch(access.type)
+                {
+                case Access::Read:
+                    spi.read(chip, access.address);
+                    break;
+                case Access::Write:
+                    spi.write(chip, access.address, 0);
+                    break;
+                case Access::Burst:
+                    spi.burst(chip, access.address, data, sizeof(data));
+                    break;
+                }
+                spi.finish();
+            }
+        }
+        double sequential = bus.elapsed(start);
+        double sequentialSkew = bus.skew();
+
+        // Interleaved
+        bus.restart();
+        start = bus.clock;
+        for(int chip = 0; chip < 2; chip++)
+        {
+            for(const Access& access : scenario.accesses)
+            {
+                switch(access.type)
+                {
+                case Access::Read:
+                    spi.queueRead(chip, access.address, data);
+                    break;
+                case Access::Write:
+                    spi.queueWrite(chip, access.address, 0);
+                    break;
+                case Access::Burst:
+                    spi.queueBurst(chip, access.address, data, sizeof(data));
+                    break;
+                }
+            }
+        }
+        spi.run();
+        double scheduled = bus.elapsed(start);
+        double scheduledSkew = bus.skew();
+        spi.finish();
+
+        out << "{\"benchmark\": \"firmware_spi_schedule\""
+            << ", \"scenario\": \"" << scenario.name << "\""
+            << ", \"sequential_us\": " << sequential
+            << ", \"scheduled_us\": " << scheduled
+            << ", \"sequential_skew_us\": " << sequentialSkew
+            << ", \"scheduled_skew_us\": " << scheduledSkew
+            << ", \"violations\": " << bus.violations << "}" << std::endl;
+    }
+}
+
+// Bring-up of both sensors: the former sequence, one sensor after the other
+// with blocking delays, against ADNS9800::boot()
+void spiBoot(std::ostream& out)
+{
+    const int SromLength = 3070;
+    const uint8_t SromId = 0xa6;
+    auto srom = [](int index)
+    {
+        return uint8_t(index == 1 ? SromId : index);
+    };
+
+    {
+        VirtualSpi bus;
+        SpiScheduler<VirtualSpi> spi(bus);
+        spi.addChip(0);
+        spi.addChip(1);
+
+        uint64_t start = bus.clock;
+        for(int chip = 0; chip < 2; chip++)
+        {
+            spi.write(chip, REG_Power_Up_Reset, 0x5a);
+            spi.finish();
+            bus.wait(50000);
+            for(uint8_t reg = REG_Motion; reg <= REG_Delta_Y_H; reg++)
+            {
+                spi.read(chip, reg);
+                spi.finish();
+            }
+            spi.write(chip, REG_Configuration_IV, 0x02);
+            spi.finish();
+            spi.write(chip, REG_SROM_Enable, 0x1d);
+            spi.finish();
+            bus.wait(10000);
+            spi.write(chip, REG_SROM_Enable, 0x18);
+            spi.finish();
+            spi.upload(&chip, 1, REG_SROM_Load_Burst, srom, SromLength, ADNS9800::SromByteTime);
+            bus.wait(10000);
+            uint8_t laser = spi.read(chip, REG_LASER_CTRL0);
+            spi.finish();
+            spi.write(chip, REG_LASER_CTRL0, laser & 0xf0);
+            spi.finish();
+            spi.write(chip, REG_Configuration_I, 0xA4);
+            spi.finish();
+            bus.wait(1000);
+        }
+
+        out << "{\"benchmark\": \"firmware_spi_boot\""
+            << ", \"scenario\": \"sequential\""
+            << ", \"uploads\": 2"
+            << ", \"boot_ms\": " << bus.elapsed(start) / 1000.0
+            << ", \"violations\": " << bus.violations << "}" << std::endl;
+    }
+
+    const struct
+    {
+        const char* name;
+        bool broadcast;
+        bool loaded;
+    } scenarios[] = {
+        {"scheduled", false, false},
+        {"broadcast", true, false},
+        {"srom_loaded", false, true}
+    };
+
+    for(const auto& scenario : scenarios)
+    {
+        VirtualSpi bus;
+        bus.response = scenario.loaded ? SromId : 0;
+        SpiScheduler<VirtualSpi> spi(bus);
+        int chips[2] = {spi.addChip(0), spi.addChip(1)};
+
+        uint64_t start = bus.clock;
+        int uploads = ADNS9800::boot(spi, chips, 2, srom, SromLength, SromId, scenario.broadcast);
+        spi.finish();
+
+        out << "{\"benchmark\": \"firmware_spi_boot\""
+            << ", \"scenario\": \"" << scenario.name << "\""
+            << ", \"uploads\": " << uploads
+            << ", \"boot_ms\": " << bus.elapsed(start) / 1000.0
+            << ", \"violations\": " << bus.violations << "}" << std::endl;
+    }
+}
+
+}
+
+bool benchmarkFirmware(unsigned int steps, std::ostream& out)
+{
+    timing(steps, out);
+    regression(std::min(steps, 1000000u), out);
+    bool passed = approximations(out);
+    passed = equivalence(std::min(steps, 1000000u), out) && passed;
+    spiSchedule(out);
+    spiBoot(out);
+    return passed;
+}
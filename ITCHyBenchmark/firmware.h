@@ -0,0 +1,15 @@
+#ifndef FIRMWARE_H
+#define FIRMWARE_H
+
+#include <ostream>
+
+// Runs the simulation step of the firmware (SimulationCore) on the host.
+// Times the step and compares it to libITCHy's Simulation fed with the same
+// increments as raw increment reports, checks the polynomial approximations
+// of the step against libm and the fixed point step against the float one.
+// Writes the results as JSON. Returns false if the approximations or the
+// fixed point step exceed the bounds stated in fastmath.h and
+// simulationfixed.h.
+bool benchmarkFirmware(unsigned int steps, std::ostream& out);
+
+#endif // FIRMWARE_H
@@ -0,0 +1,80 @@
+#include "firmware.h"
+#include "microbenchmark.h"
+#include "prediction.h"
+#include "replay.h"
+#include "trace.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace
+{
+
+void usage()
+{
+    std::cerr << "Usage:\n"
+              << "  ITCHyBenchmark record <recording> <seconds>\n"
+              << "  ITCHyBenchmark prediction <recording|trace>\n"
+              << "  ITCHyBenchmark replay <recording> [speed]\n"
+              << "  ITCHyBenchmark micro [iterations]\n"
+              << "  ITCHyBenchmark firmware [steps]\n";
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        usage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+
+    if(command == "micro")
+    {
+        unsigned int iterations = (argc > 2) ? std::atoi(argv[2]) : 100000;
+        benchmarkMicro(iterations, std::cout);
+        return 0;
+    }
+
+    if(command == "firmware")
+    {
+        unsigned int steps = (argc > 2) ? std::atoi(argv[2]) : 10000000;
+        return benchmarkFirmware(steps, std::cout) ? 0 : 1;
+    }
+
+    if(argc < 3)
+    {
+        usage();
+        return 1;
+    }
+
+    if(command == "record" && argc == 4)
+    {
+        return recordSession(argv[2], std::atof(argv[3])) ? 0 : 1;
+    }
+
+    if(command == "replay")
+    {
+        double speed = (argc > 3) ? std::atof(argv[3]) : 0.0;
+        return benchmarkReplay(argv[2], speed, std::cout) ? 0 : 1;
+    }
+
+    if(command == "prediction")
+    {
+        Trace trace;
+        if(!loadTrace(argv[2], trace))
+        {
+            return 1;
+        }
+
+        benchmarkPrediction(trace, std::cout);
+        return 0;
+    }
+
+    usage();
+    return 1;
+}
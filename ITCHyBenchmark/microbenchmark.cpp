@@ -0,0 +1,289 @@
+#include "microbenchmark.h"
+
+#include <itchy/itchy.h>
+#include <itchy/protocol.h>
+#include <itchy/simulation.h>
+#ifndef ITCHY_NOSCRATCHY
+#include <itchy/tactilemousequery.h>
+#endif
+#include <itchy/transport.h>
+#include <itchyimplementation.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+uint64_t now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return uint64_t(time.tv_sec) * 1000000000ull + uint64_t(time.tv_nsec);
+}
+
+double percentile(std::vector<double>& values, double p)
+{
+    if(values.empty())
+    {
+        return 0.0;
+    }
+
+    size_t index = std::min(values.size() - 1, size_t(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Writes mean and percentiles of the per operation times [ns]
+void report(std::ostream& out, const char* name, std::vector<double>& samples,
+            const char* extra = "")
+{
+    double sum = 0.0;
+    for(double sample : samples)
+    {
+        sum += sample;
+    }
+
+    out << "{\"benchmark\": \"" << name << "\""
+        << ", \"iterations\": " << samples.size()
+        << ", \"ns_per_op\": " << (samples.empty() ? 0.0 : sum / samples.size())
+        << ", \"p50\": " << percentile(samples, 0.50)
+        << ", \"p90\": " << percentile(samples, 0.90)
+        << ", \"p99\": " << percentile(samples, 0.99)
+        << ", \"max\": " << (samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end()))
+        << extra << "}" << std::endl;
+}
+
+// Report with an increasing device time
+void pushFrame(LoopbackTransport* transport, uint32_t deviceTime)
+{
+    char report[ITCHyProtocol::ReportSize] = {0};
+    memcpy(report + ITCHyProtocol::Offset::DeviceTime, &deviceTime, sizeof(deviceTime));
+    transport->pushReport(report, sizeof(report));
+}
+
+// Operations too short for the clock resolution are timed in batches
+const unsigned int Batch = 64;
+
+void decode(unsigned int iterations, std::ostream& out)
+{
+    LoopbackTransport* transport = new LoopbackTransport();
+    ITCHy mouse({0, 0, 0, 0}, transport);
+    mouse.tryConnect();
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for(unsigned int n = 0; n < iterations; n++)
+    {
+        pushFrame(transport, n * 1000);
+
+        uint64_t start = now();
+        mouse.currentState(0);
+        samples.push_back(now() - start);
+    }
+
+    mouse.disconnect();
+    report(out, "decode_current_state", samples);
+}
+
+void dispatch(unsigned int iterations, unsigned int callbacks, std::ostream& out)
+{
+    ITCHyImplementation implementation;
+    std::atomic<unsigned int> calls{0};
+    for(unsigned int n = 0; n < callbacks; n++)
+    {
+        implementation.callbacks[size_t(ITCHy::CallbackType::Connected)].push_back([&calls](){ calls++; });
+    }
+
+    std::vector<double> samples;
+    samples.reserve(iterations / Batch);
+    for(unsigned int n = 0; n < iterations / Batch; n++)
+    {
+        uint64_t start = now();
+        for(unsigned int b = 0; b < Batch; b++)
+        {
+            implementation.callAll(ITCHy::CallbackType::Connected);
+        }
+        samples.push_back(double(now() - start) / Batch);
+    }
+
+    std::string name = "call_all_" + std::to_string(callbacks);
+    report(out, name.c_str(), samples);
+}
+
+#ifndef ITCHY_NOSCRATCHY
+void attachedUpdate(unsigned int iterations, std::ostream& out)
+{
+    LoopbackTransport* transport = new LoopbackTransport();
+    TactileMouseQuery query(transport, false, 0);
+    query.initialize();
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for(unsigned int n = 0; n < iterations; n++)
+    {
+        pushFrame(transport, n * 1000);
+
+        uint64_t start = now();
+        query.update();
+        samples.push_back(now() - start);
+    }
+
+    report(out, "tmq_update_attached", samples);
+}
+
+void detachedUpdate(unsigned int iterations, std::ostream& out)
+{
+    LoopbackTransport* transport = new LoopbackTransport();
+    TactileMouseQuery query(transport, true, 0);
+    query.initialize();
+
+    // Frames arrive at 10 kHz while the consumer updates continuously
+    std::atomic<bool> running{true};
+    std::thread device([&]()
+    {
+        for(uint32_t n = 0; running; n++)
+        {
+            pushFrame(transport, n * 100);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    std::vector<double> samples;
+    samples.reserve(iterations / Batch);
+    for(unsigned int n = 0; n < iterations / Batch; n++)
+    {
+        uint64_t start = now();
+        for(unsigned int b = 0; b < Batch; b++)
+        {
+            query.update();
+        }
+        samples.push_back(double(now() - start) / Batch);
+    }
+
+    running = false;
+    device.join();
+    report(out, "tmq_update_detached", samples);
+}
+#endif
+
+// The device pushes bursts of frames far above the real frame rate, the
+// reader thread receives them into the ring while the consumer drains it
+void contention(unsigned int iterations, std::ostream& out)
+{
+    LoopbackTransport* transport = new LoopbackTransport();
+    ITCHy mouse({0, 0, 0, 0}, transport);
+    mouse.tryConnect();
+    mouse.startReceiving(1024);
+
+    uint64_t start = now();
+    std::thread device([&]()
+    {
+        for(unsigned int n = 0; n < iterations; n++)
+        {
+            pushFrame(transport, n * 10);
+            if(n % 16 == 15)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    });
+
+    std::vector<double> consume;
+    std::vector<double> latency;
+    latency.reserve(iterations);
+    size_t consumed = 0;
+    while(consumed < mouse.frameCount() || mouse.frameCount() < iterations)
+    {
+        uint64_t begin = now();
+        size_t count = mouse.consumeStates([&](const ITCHy::StateSpan& states)
+        {
+            uint64_t time = now();
+            for(const ITCHy::State& state : states)
+            {
+                latency.push_back(double(time - state.hostTime));
+            }
+        });
+        uint64_t end = now();
+
+        if(count > 0)
+        {
+            consume.push_back(double(end - begin) / count);
+            consumed += count;
+        }
+        else if(mouse.frameCount() >= iterations)
+        {
+            // Remaining frames have been dropped by a full ring
+            break;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    double seconds = (now() - start) * 1e-9;
+
+    device.join();
+    mouse.disconnect();
+
+    std::string extra = ", \"frames\": " + std::to_string(mouse.frameCount()) +
+                        ", \"consumed\": " + std::to_string(consumed) +
+                        ", \"dropped\": " + std::to_string(mouse.frameCount() - consumed) +
+                        ", \"frames_per_second\": " + std::to_string(mouse.frameCount() / seconds);
+    report(out, "contention_consume_per_frame", consume, extra.c_str());
+    report(out, "contention_receive_to_consume", latency);
+}
+
+// One step of all variants of a host simulation
+void simulation(unsigned int iterations, Simulation::Integrator integrator,
+                unsigned int variants, std::ostream& out)
+{
+    Simulation simulation(integrator);
+    for(unsigned int n = 0; n < variants; n++)
+    {
+        simulation.addVariant({0.1f, 1000.0f + 100.0f * n, 30.0f});
+    }
+
+    vec2f left = {{1e-6f, 2e-6f}};
+    vec2f right = {{-1e-6f, 2e-6f}};
+
+    std::vector<double> samples;
+    samples.reserve(iterations / Batch);
+    for(unsigned int n = 0; n < iterations / Batch; n++)
+    {
+        uint64_t start = now();
+        for(unsigned int b = 0; b < Batch; b++)
+        {
+            simulation.step(left, right, 0.0005f);
+        }
+        samples.push_back(double(now() - start) / Batch);
+    }
+
+    const char* names[] = {"symplectic_euler", "velocity_verlet", "runge_kutta4"};
+    std::string name = std::string("simulation_") + names[int(integrator)] +
+                       "_" + std::to_string(variants);
+    report(out, name.c_str(), samples);
+}
+
+}
+
+void benchmarkMicro(unsigned int iterations, std::ostream& out)
+{
+    decode(iterations, out);
+    dispatch(iterations * 16, 1, out);
+    dispatch(iterations * 16, 4, out);
+#ifndef ITCHY_NOSCRATCHY
+    attachedUpdate(iterations, out);
+    detachedUpdate(iterations * 16, out);
+#endif
+    contention(iterations * 10, out);
+    simulation(iterations, Simulation::Integrator::VelocityVerlet, 1, out);
+    simulation(iterations, Simulation::Integrator::SymplecticEuler, 64, out);
+    simulation(iterations, Simulation::Integrator::VelocityVerlet, 64, out);
+    simulation(iterations, Simulation::Integrator::RungeKutta4, 64, out);
+}
@@ -0,0 +1,13 @@
+#ifndef MICROBENCHMARK_H
+#define MICROBENCHMARK_H
+
+#include <ostream>
+
+// Measures the host side hot paths of libITCHy without hardware, using
+// LoopbackTransport: frame decoding in ITCHy::currentState(), callback
+// dispatch, TactileMouseQuery::update() in attached and detached mode and
+// background reception with a concurrent consumer.
+// Writes one JSON object per benchmark and line with ns/op and percentiles.
+void benchmarkMicro(unsigned int iterations, std::ostream& out);
+
+#endif // MICROBENCHMARK_H
@@ -0,0 +1,166 @@
+#include "prediction.h"
+
+#include <itchy/motionpredictor.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Frames used for settling the estimator before measuring
+const size_t WarmUp = 10;
+
+const double Horizons[] = {0.005, 0.010, 0.020, 0.050}; // [s]
+
+struct Model
+{
+    const char* name;
+    bool predict;
+    ITCHy::PredictionModel model;
+};
+
+const Model Models[] = {
+    {"none", false, ITCHy::PredictionModel::ConstantVelocity},
+    {"constant_velocity", true, ITCHy::PredictionModel::ConstantVelocity},
+    {"constant_acceleration", true, ITCHy::PredictionModel::ConstantAcceleration}
+};
+
+// The device scales the orientation by 0.75, wrapping it within 1.5 pi
+const double AngleRange = 1.5 * M_PI;
+
+// Difference of two angles, wrapped into +-0.75 pi
+double angleDifference(double a, double b)
+{
+    return std::remainder(a - b, AngleRange);
+}
+
+struct Errors
+{
+    std::vector<double> position;
+    std::vector<double> angle;
+};
+
+// Recorded pose at the given time, linearly interpolated between frames
+bool recorded(const Trace& trace, size_t from, uint64_t time, ITCHy::State& state)
+{
+    size_t next = from;
+    while(next < trace.size() && trace[next].sampleTime < time)
+    {
+        next++;
+    }
+
+    if(next >= trace.size() || next == 0)
+    {
+        return false;
+    }
+
+    const TraceFrame& a = trace[next - 1];
+    const TraceFrame& b = trace[next];
+    double t = double(time - a.sampleTime) / double(b.sampleTime - a.sampleTime);
+
+    state = b.state;
+    for(int i = 0; i < 2; i++)
+    {
+        state.position[i] = float(a.state.position[i] + t * (b.state.position[i] - a.state.position[i]));
+    }
+
+    // Unwrapped, the angle may have jumped by 1.5 pi between the frames
+    state.angle = float(a.state.angle + t * angleDifference(b.state.angle, a.state.angle));
+    return true;
+}
+
+double percentile(std::vector<double>& values, double p)
+{
+    if(values.empty())
+    {
+        return 0.0;
+    }
+
+    size_t index = std::min(values.size() - 1, size_t(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void writeStatistics(std::vector<double>& values, std::ostream& out)
+{
+    double sum = 0.0;
+    double squares = 0.0;
+    for(double value : values)
+    {
+        sum += value;
+        squares += value * value;
+    }
+
+    size_t n = std::max<size_t>(values.size(), 1);
+    out << "{\"mean\": " << sum / n
+        << ", \"rms\": " << std::sqrt(squares / n)
+        << ", \"p50\": " << percentile(values, 0.50)
+        << ", \"p95\": " << percentile(values, 0.95)
+        << ", \"p99\": " << percentile(values, 0.99)
+        << ", \"max\": " << (values.empty() ? 0.0 : *std::max_element(values.begin(), values.end()))
+        << "}";
+}
+
+}
+
+void benchmarkPrediction(const Trace& trace, std::ostream& out)
+{
+    const size_t horizons = sizeof(Horizons) / sizeof(Horizons[0]);
+    const size_t models = sizeof(Models) / sizeof(Models[0]);
+    std::vector<Errors> errors(horizons * models);
+
+    MotionPredictor predictor;
+    for(size_t i = 0; i < trace.size(); i++)
+    {
+        predictor.addFrame(trace[i].state, trace[i].sampleTime);
+        if(i < WarmUp)
+        {
+            continue;
+        }
+
+        for(size_t h = 0; h < horizons; h++)
+        {
+            uint64_t time = trace[i].sampleTime + uint64_t(Horizons[h] * 1e9);
+
+            ITCHy::State truth;
+            if(!recorded(trace, i, time, truth))
+            {
+                continue;
+            }
+
+            for(size_t m = 0; m < models; m++)
+            {
+                ITCHy::State predicted = Models[m].predict ?
+                            predictor.predict(time, Models[m].model) :
+                            trace[i].state;
+
+                double dx = predicted.position[0] - truth.position[0];
+                double dy = predicted.position[1] - truth.position[1];
+
+                Errors& e = errors[h * models + m];
+                e.position.push_back(std::sqrt(dx * dx + dy * dy) * 1000.0);
+                e.angle.push_back(std::fabs(angleDifference(predicted.angle, truth.angle)));
+            }
+        }
+    }
+
+    out << "{\"benchmark\": \"prediction\", \"frames\": " << trace.size()
+        << ", \"results\": [\n";
+    for(size_t h = 0; h < horizons; h++)
+    {
+        for(size_t m = 0; m < models; m++)
+        {
+            Errors& e = errors[h * models + m];
+            out << "  {\"model\": \"" << Models[m].name
+                << "\", \"horizon_ms\": " << Horizons[h] * 1000.0
+                << ", \"samples\": " << e.position.size()
+                << ", \"position_mm\": ";
+            writeStatistics(e.position, out);
+            out << ", \"angle_rad\": ";
+            writeStatistics(e.angle, out);
+            out << "}" << ((h + 1 < horizons || m + 1 < models) ? ",\n" : "\n");
+        }
+    }
+    out << "]}" << std::endl;
+}
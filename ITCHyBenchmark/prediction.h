@@ -0,0 +1,13 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include "trace.h"
+
+#include <ostream>
+
+// Replays a trace through MotionPredictor and compares the extrapolated pose
+// to the recorded one for several prediction horizons. Writes the position
+// [mm] and angle [rad] errors per model and horizon as JSON.
+void benchmarkPrediction(const Trace& trace, std::ostream& out);
+
+#endif // PREDICTION_H
@@ -0,0 +1,83 @@
+#include "replay.h"
+
+#include <itchy/itchy.h>
+#include <itchy/transport.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+uint64_t now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return uint64_t(time.tv_sec) * 1000000000ull + uint64_t(time.tv_nsec);
+}
+
+double percentile(std::vector<double>& values, double p)
+{
+    if(values.empty())
+    {
+        return 0.0;
+    }
+
+    size_t index = std::min(values.size() - 1, size_t(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+}
+
+bool benchmarkReplay(const std::string& fileName, double speed, std::ostream& out)
+{
+    ReplayTransport* transport = new ReplayTransport(fileName, speed);
+    ITCHy mouse({0, 0, 0, 0}, transport);
+    if(!mouse.tryConnect())
+    {
+        std::cerr << "Cannot open " << fileName << std::endl;
+        return false;
+    }
+
+    std::vector<ITCHy::State> states;
+    std::vector<double> delays;
+
+    uint64_t start = now();
+    mouse.startReceiving(65536);
+    while(!transport->finished() || mouse.frameCount() > delays.size())
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+
+        states.clear();
+        mouse.drainStates(states);
+
+        uint64_t drained = now();
+        for(const ITCHy::State& state : states)
+        {
+            delays.push_back((drained - state.hostTime) * 1e-3);
+        }
+
+        if(states.empty() && transport->finished())
+        {
+            break;
+        }
+    }
+    double seconds = (now() - start) * 1e-9;
+    mouse.disconnect();
+
+    out << "{\"benchmark\": \"replay\", \"speed\": " << speed
+        << ", \"frames\": " << delays.size()
+        << ", \"seconds\": " << seconds
+        << ", \"frames_per_second\": " << delays.size() / seconds
+        << ", \"drain_delay_us\": {\"p50\": " << percentile(delays, 0.50)
+        << ", \"p99\": " << percentile(delays, 0.99)
+        << ", \"max\": " << (delays.empty() ? 0.0 : *std::max_element(delays.begin(), delays.end()))
+        << "}}" << std::endl;
+
+    return true;
+}
@@ -0,0 +1,13 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <ostream>
+#include <string>
+
+// Feeds a session recording through ITCHy using ReplayTransport and
+// background reception. Writes the frame throughput and the delay between
+// a frame being received and being drained by the consumer as JSON.
+// A speed of 0 replays as fast as possible.
+bool benchmarkReplay(const std::string& fileName, double speed, std::ostream& out);
+
+#endif // REPLAY_H
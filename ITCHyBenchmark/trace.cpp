@@ -0,0 +1,132 @@
+#include "trace.h"
+
+#include <itchy/sessionrecorder.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+
+// Frames are timed by the device clock, relative to the first frame
+void loadSession(const SessionReader& reader, Trace& trace)
+{
+    bool started = false;
+    uint32_t lastDeviceTime = 0;
+    uint64_t sampleTime = 0;
+
+    for(uint64_t n = 0; n < reader.recordCount(); n++)
+    {
+        const SessionRecord& record = reader.record(n);
+        if(record.type != SessionRecord::Frame)
+        {
+            continue;
+        }
+
+        TraceFrame frame;
+        frame.state = SessionReader::frame(record);
+
+        if(frame.state.deviceTime == 0)
+        {
+            sampleTime = record.hostTime;
+        }
+        else if(!started)
+        {
+            sampleTime = record.hostTime;
+        }
+        else
+        {
+            sampleTime += int64_t(int32_t(frame.state.deviceTime - lastDeviceTime)) * 1000;
+        }
+
+        started = true;
+        lastDeviceTime = frame.state.deviceTime;
+        frame.sampleTime = sampleTime;
+        trace.push_back(frame);
+    }
+}
+
+}
+
+bool loadTrace(const std::string& fileName, Trace& trace)
+{
+    SessionReader reader;
+    if(reader.open(fileName))
+    {
+        loadSession(reader, trace);
+        return true;
+    }
+
+    std::ifstream file(fileName);
+    if(!file)
+    {
+        std::cerr << "Cannot open " << fileName << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+        if(line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        TraceFrame frame;
+        frame.state = ITCHy::State();
+
+        std::istringstream stream(line);
+        stream >> frame.sampleTime
+               >> frame.state.position[0]
+               >> frame.state.position[1]
+               >> frame.state.angle;
+
+        if(!stream)
+        {
+            std::cerr << "Malformed line in " << fileName << ": " << line << std::endl;
+            return false;
+        }
+
+        frame.state.hostTime = frame.sampleTime;
+        trace.push_back(frame);
+    }
+
+    return true;
+}
+
+bool recordSession(const std::string& fileName, double seconds)
+{
+    SessionRecorder recorder;
+    if(!recorder.open(fileName))
+    {
+        std::cerr << "Cannot open " << fileName << std::endl;
+        return false;
+    }
+
+    ITCHy mouse;
+    mouse.setRecorder(&recorder);
+    if(!mouse.connect(1000) || !mouse.startReceiving(4096))
+    {
+        std::cerr << "No device found" << std::endl;
+        return false;
+    }
+
+    auto end = std::chrono::steady_clock::now() +
+               std::chrono::microseconds(int64_t(seconds * 1e6));
+
+    std::vector<ITCHy::State> states;
+    while(mouse.connected() && std::chrono::steady_clock::now() < end)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        states.clear();
+        mouse.drainStates(states);
+    }
+
+    mouse.disconnect();
+    mouse.setRecorder(nullptr);
+    std::cerr << recorder.recordCount() << " records" << std::endl;
+    return true;
+}
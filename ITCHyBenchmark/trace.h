@@ -0,0 +1,26 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <itchy/itchy.h>
+
+#include <string>
+#include <vector>
+
+// Recorded device motion, loaded either from a session recording (see
+// itchy/sessionrecorder.h) or from a text file with one frame per line:
+//   sampleTime[ns] x[m] y[m] angle[rad]
+// Lines starting with '#' are ignored.
+struct TraceFrame
+{
+    uint64_t sampleTime;
+    ITCHy::State state;
+};
+
+using Trace = std::vector<TraceFrame>;
+
+bool loadTrace(const std::string& fileName, Trace& trace);
+
+// Records a session of the first attached device for the given duration
+bool recordSession(const std::string& fileName, double seconds);
+
+#endif // TRACE_H
@@ -85,8 +85,9 @@ void MainWindow::disconnected()
 void MainWindow::pollMouse()
 {
     const ITCHy::State& state = mouse.currentState();
-    if(state.time != 0)
+    if(mouse.frameCount() == lastFrame)
         return;
+    lastFrame = mouse.frameCount();
 
     qDebug() << state.position[0] << "," << state.position[1] << " / " << state.angle;
     qDebug() << state.leftIncrement[0] << "\t" << state.leftIncrement[1] << "\t/\t" << state.rightIncrement[0] << "\t" << state.rightIncrement[1];
@@ -125,7 +126,7 @@ void MainWindow::pollMouse()
     // Change color on thumb button press:
     if(state.button == 1)
     {
-        mouse.setColor({{200, 255, 200}});
+        mouse.setColorAsync({{200, 255, 200}});
     }
 }
 
@@ -138,14 +139,14 @@ void MainWindow::updateColor()
     if(clt > 1.0)
         clt -= 1.0;
     QColor cl = QColor::fromHsvF(clt, 1.0, 1.0, 1.0);
-    mouse.setColor({{uint8_t(cl.red()),
-                     uint8_t(cl.green()),
-                     uint8_t(cl.blue())}});
+    mouse.setColorAsync({{uint8_t(cl.red()),
+                          uint8_t(cl.green()),
+                          uint8_t(cl.blue())}});
 }
 
 void MainWindow::updateParameters()
 {
-    mouse.setSimulationParameters(
+    mouse.setSimulationParametersAsync(
                 spinMass->value(),
                 spinStiffness->value(),
                 spinDamping->value(),
@@ -155,7 +156,7 @@ void MainWindow::updateParameters()
 
 void MainWindow::updateCalibration()
 {
-    mouse.setCalibrationParameters({{
+    mouse.setCalibrationParametersAsync({{
                                         float(spinCalibrationWidth->value() * 0.01),
                                         float(spinCalibrationHeight->value() * 0.01)
                                     }});
@@ -30,6 +30,7 @@ private:
     QTimer timer;
     QTimer colortimer;
     float clt = 0.0;
+    uint64_t lastFrame = 0;
 
     QGraphicsScene* scene;
 
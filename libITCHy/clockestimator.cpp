@@ -0,0 +1,197 @@
+#include "clockestimator.h"
+
+ClockEstimator::ClockEstimator()
+{
+}
+
+void ClockEstimator::reset()
+{
+    started = false;
+    blockEmpty = true;
+    minima.clear();
+
+    Model model = Model();
+    model.valid = false;
+    publish(model);
+}
+
+void ClockEstimator::addSample(uint32_t deviceTime, uint64_t hostTime)
+{
+    if(!started)
+    {
+        started = true;
+        lastRaw = deviceTime;
+        unwrapped = deviceTime;
+        deviceReference = unwrapped;
+        hostReference = hostTime;
+        blockStart = 0.0;
+        blockEmpty = true;
+    }
+    else
+    {
+        // The device counter wraps after ~71 minutes. Large backward jumps
+        // indicate a restart of the device.
+        int32_t step = int32_t(deviceTime - lastRaw);
+        if(step < -RestartThreshold)
+        {
+            reset();
+            addSample(deviceTime, hostTime);
+            return;
+        }
+
+        unwrapped += step;
+        lastRaw = deviceTime;
+    }
+
+    Point sample;
+    sample.device = double(unwrapped - deviceReference);
+    sample.residual = double(int64_t(hostTime - hostReference)) - sample.device * 1000.0;
+
+    if(sample.device - blockStart >= BlockLength)
+    {
+        minima.push_back(blockMinimum);
+        if(minima.size() > MaxBlocks)
+        {
+            minima.pop_front();
+        }
+
+        blockStart = sample.device;
+        blockEmpty = true;
+    }
+
+    if(blockEmpty || sample.residual < blockMinimum.residual)
+    {
+        blockMinimum = sample;
+        blockEmpty = false;
+    }
+
+    fit();
+}
+
+void ClockEstimator::fit()
+{
+    Model model;
+    model.valid = true;
+    model.latestRaw = lastRaw;
+    model.latestDevice = unwrapped;
+    model.deviceReference = deviceReference;
+    model.hostReference = hostReference;
+
+    if(minima.size() < 2)
+    {
+        // Not enough data for estimating the drift yet
+        double minimum = blockMinimum.residual;
+        for(const Point& p : minima)
+        {
+            if(p.residual < minimum)
+            {
+                minimum = p.residual;
+            }
+        }
+
+        model.intercept = minimum;
+        model.slope = 0.0;
+        publish(model);
+        return;
+    }
+
+    // Least squares line through the block minima
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for(const Point& p : minima)
+    {
+        meanX += p.device;
+        meanY += p.residual;
+    }
+    meanX /= minima.size();
+    meanY /= minima.size();
+
+    double sxy = 0.0;
+    double sxx = 0.0;
+    for(const Point& p : minima)
+    {
+        sxy += (p.device - meanX) * (p.residual - meanY);
+        sxx += (p.device - meanX) * (p.device - meanX);
+    }
+
+    model.slope = (sxx > 0.0) ? sxy / sxx : 0.0;
+    model.intercept = meanY - model.slope * meanX;
+    publish(model);
+}
+
+void ClockEstimator::publish(const Model& model)
+{
+    sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    valid.store(model.valid, std::memory_order_relaxed);
+    latestRaw.store(model.latestRaw, std::memory_order_relaxed);
+    latestDevice.store(model.latestDevice, std::memory_order_relaxed);
+    publishedDeviceReference.store(model.deviceReference, std::memory_order_relaxed);
+    publishedHostReference.store(model.hostReference, std::memory_order_relaxed);
+    intercept.store(model.intercept, std::memory_order_relaxed);
+    slope.store(model.slope, std::memory_order_relaxed);
+
+    sequence.fetch_add(1, std::memory_order_release);
+}
+
+ClockEstimator::Model ClockEstimator::load() const
+{
+    Model model;
+    uint32_t before, after;
+    do
+    {
+        before = sequence.load(std::memory_order_acquire);
+
+        model.valid = valid.load(std::memory_order_relaxed);
+        model.latestRaw = latestRaw.load(std::memory_order_relaxed);
+        model.latestDevice = latestDevice.load(std::memory_order_relaxed);
+        model.deviceReference = publishedDeviceReference.load(std::memory_order_relaxed);
+        model.hostReference = publishedHostReference.load(std::memory_order_relaxed);
+        model.intercept = intercept.load(std::memory_order_relaxed);
+        model.slope = slope.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence.load(std::memory_order_relaxed);
+    } while(before != after || (before & 1));
+
+    return model;
+}
+
+bool ClockEstimator::toHost(uint32_t deviceTime, uint64_t& hostTime) const
+{
+    Model model = load();
+    if(!model.valid)
+    {
+        return false;
+    }
+
+    // Unwrap relative to the latest sample
+    int64_t device = model.latestDevice + int32_t(deviceTime - model.latestRaw);
+    double x = double(device - model.deviceReference);
+    double host = x * 1000.0 + model.intercept + model.slope * x;
+
+    hostTime = model.hostReference + int64_t(host);
+    return true;
+}
+
+ITCHy::ClockEstimate ClockEstimator::estimate() const
+{
+    Model model = load();
+
+    ITCHy::ClockEstimate estimate;
+    estimate.valid = model.valid;
+    estimate.offset = 0.0;
+    estimate.drift = 0.0;
+
+    if(model.valid)
+    {
+        double x = double(model.latestDevice - model.deviceReference);
+        estimate.offset = double(int64_t(model.hostReference)) -
+                          double(model.deviceReference) * 1000.0 +
+                          model.intercept + model.slope * x;
+        estimate.drift = model.slope * 1000.0;
+    }
+
+    return estimate;
+}
@@ -0,0 +1,75 @@
+#ifndef CLOCKESTIMATOR_H
+#define CLOCKESTIMATOR_H
+
+#include "itchy/itchy.h"
+
+#include <atomic>
+#include <deque>
+
+// Running estimate of the offset and drift between the device clock [us]
+// and the host CLOCK_MONOTONIC [ns].
+// The USB transfer delay is always positive, therefore only the frames with
+// the lowest delay within blocks of BlockLength are used for fitting a line
+// to the most recent MaxBlocks blocks.
+// Samples have to be added from a single thread, the mapping functions may
+// be used from any thread.
+class ClockEstimator
+{
+public:
+    ClockEstimator();
+
+    void addSample(uint32_t deviceTime, uint64_t hostTime);
+    void reset();
+
+    bool toHost(uint32_t deviceTime, uint64_t& hostTime) const;
+    ITCHy::ClockEstimate estimate() const;
+
+private:
+    static const int64_t BlockLength = 200000; // [us]
+    static const size_t MaxBlocks = 50;
+    static const int32_t RestartThreshold = 1000000; // [us]
+
+    struct Point
+    {
+        double device;      // Device time since reference [us]
+        double residual;    // Host time minus device time [ns]
+    };
+
+    struct Model
+    {
+        bool valid;
+        uint32_t latestRaw;
+        int64_t latestDevice;
+        int64_t deviceReference;
+        uint64_t hostReference;
+        double intercept;
+        double slope;
+    };
+
+    void fit();
+    void publish(const Model& model);
+    Model load() const;
+
+    // Producer state
+    bool started = false;
+    uint32_t lastRaw = 0;
+    int64_t unwrapped = 0;
+    int64_t deviceReference = 0;
+    uint64_t hostReference = 0;
+    double blockStart = 0.0;
+    bool blockEmpty = true;
+    Point blockMinimum;
+    std::deque<Point> minima;
+
+    // Published model (seqlock)
+    mutable std::atomic<uint32_t> sequence{0};
+    std::atomic<bool> valid{false};
+    std::atomic<uint32_t> latestRaw{0};
+    std::atomic<int64_t> latestDevice{0};
+    std::atomic<int64_t> publishedDeviceReference{0};
+    std::atomic<uint64_t> publishedHostReference{0};
+    std::atomic<double> intercept{0.0};
+    std::atomic<double> slope{0.0};
+};
+
+#endif // CLOCKESTIMATOR_H
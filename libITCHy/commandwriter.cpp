@@ -0,0 +1,174 @@
+#include "commandwriter.h"
+#include "itchy/sessionrecorder.h"
+#include "itchy/transport.h"
+
+CommandWriter::CommandWriter(ITCHy::Transport* transport, const std::function<void()>& onError) :
+    transport(transport),
+    onError(onError)
+{
+}
+
+CommandWriter::~CommandWriter()
+{
+    stop();
+}
+
+void CommandWriter::start()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if(running)
+    {
+        return;
+    }
+
+    // Restarted from within a callback, the writer thread keeps serving
+    if(isWriterThread())
+    {
+        running = true;
+        return;
+    }
+
+    // Collect a writer thread that has been stopped from within itself
+    lock.unlock();
+    if(writer.joinable())
+    {
+        writer.join();
+    }
+    lock.lock();
+
+    running = true;
+    writer = std::thread([this](){ run(); });
+}
+
+void CommandWriter::stop()
+{
+    std::deque<Pending> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        failed.swap(queue);
+    }
+    condition.notify_all();
+
+    for(Pending& pending : failed)
+    {
+        for(std::promise<bool>& promise : pending.promises)
+        {
+            promise.set_value(false);
+        }
+    }
+
+    // The writer thread itself may end up here via a callback
+    if(writer.joinable() && !isWriterThread())
+    {
+        writer.join();
+        writerId = std::thread::id();
+    }
+}
+
+bool CommandWriter::isWriterThread() const
+{
+    return writerId.load() == std::this_thread::get_id();
+}
+
+void CommandWriter::setRecorder(SessionRecorder* recorder)
+{
+    this->recorder = recorder;
+}
+
+bool CommandWriter::coalescable(const Command& command)
+{
+    switch(command.buffer[0])
+    {
+    case ITCHyProtocol::CalibrationData:
+    case ITCHyProtocol::SimulationData:
+    case ITCHyProtocol::SetColor:
+    case ITCHyProtocol::SetReportFormat:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+std::future<bool> CommandWriter::submit(const Command& command)
+{
+    std::promise<bool> promise;
+    std::future<bool> future = promise.get_future();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if(!running)
+    {
+        lock.unlock();
+        promise.set_value(false);
+        return future;
+    }
+
+    if(coalescable(command))
+    {
+        // Look for a pending command of the same kind, but do not move a
+        // command across a different, non coalescable one
+        for(auto pending = queue.rbegin(); pending != queue.rend(); ++pending)
+        {
+            if(pending->command.buffer[0] == command.buffer[0])
+            {
+                pending->command = command;
+                pending->promises.push_back(std::move(promise));
+                return future;
+            }
+
+            if(!coalescable(pending->command))
+            {
+                break;
+            }
+        }
+    }
+
+    Pending pending;
+    pending.command = command;
+    pending.promises.push_back(std::move(promise));
+    queue.push_back(std::move(pending));
+
+    lock.unlock();
+    condition.notify_one();
+    return future;
+}
+
+void CommandWriter::run()
+{
+    writerId = std::this_thread::get_id();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        condition.wait(lock, [this](){ return !running || !queue.empty(); });
+        if(!running)
+        {
+            break;
+        }
+
+        Pending pending = std::move(queue.front());
+        queue.pop_front();
+
+        lock.unlock();
+        if(SessionRecorder* sessionRecorder = recorder.load())
+        {
+            sessionRecorder->recordCommand(pending.command.buffer);
+        }
+
+        bool success = transport->send(pending.command.buffer, ITCHyProtocol::ReportSize,
+                                       pending.command.timeout) > 0;
+        if(!success)
+        {
+            onError();
+        }
+
+        for(std::promise<bool>& promise : pending.promises)
+        {
+            promise.set_value(success);
+        }
+        lock.lock();
+    }
+
+    writerId = std::thread::id();
+}
@@ -0,0 +1,72 @@
+#ifndef COMMANDWRITER_H
+#define COMMANDWRITER_H
+
+#include "itchy/itchy.h"
+#include "itchy/protocol.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+class SessionRecorder;
+
+// Sends commands to the device from its own thread, in submission order.
+// A pending color, simulation, calibration or report format command is
+// replaced by a newer one of the same kind unless another command has been
+// queued in between.
+// Superseded commands report the result of the command replacing them.
+class CommandWriter
+{
+public:
+    struct Command
+    {
+        char buffer[ITCHyProtocol::ReportSize];
+        int timeout;    // [ms]
+    };
+
+    CommandWriter(ITCHy::Transport* transport, const std::function<void()>& onError);
+    ~CommandWriter();
+
+    void start();
+
+    // Stops the writer thread, pending commands fail
+    void stop();
+
+    std::future<bool> submit(const Command& command);
+
+    // True if called from within the writer thread, e.g. by a callback
+    bool isWriterThread() const;
+
+    // Records all commands sent, nullptr disables recording
+    void setRecorder(SessionRecorder* recorder);
+
+private:
+    struct Pending
+    {
+        Command command;
+        std::vector<std::promise<bool>> promises;
+    };
+
+    static bool coalescable(const Command& command);
+    void run();
+
+    ITCHy::Transport* transport;
+    std::function<void()> onError;
+
+    std::thread writer;
+
+    // Set by the writer thread while it runs, as writer may be reassigned
+    // by start() while isWriterThread() is called from any thread
+    std::atomic<std::thread::id> writerId{std::thread::id()};
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Pending> queue;
+    bool running = false;
+
+    std::atomic<SessionRecorder*> recorder{nullptr};
+};
+
+#endif // COMMANDWRITER_H
@@ -0,0 +1,285 @@
+#include "itchy/devicemanager.h"
+#include "itchy/transport.h"
+#include "itchyimplementation.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <deque>
+#include <mutex>
+
+struct DeviceManager::impl
+{
+    static const uint32_t Wakeup = UINT32_MAX;
+
+    DeviceIdentifier identifier;
+    int epoll = -1;
+    int wakeup = -1;
+
+    std::thread io;
+    std::atomic<bool> running{false};
+
+    // Guards the device vectors. Never held while user code runs, so
+    // callbacks may use the manager.
+    mutable std::mutex mutex;
+    std::vector<ITCHy*> devices;
+    std::vector<ITCHy::Transport*> transports;
+    std::vector<std::string> serials;
+    std::vector<bool> registered;
+
+    // Held by the I/O thread while servicing a device, which must not be
+    // removed meanwhile. Taken before the mutex.
+    std::deque<std::mutex> servicing;
+
+    SPSCRing<Frame> frames{4096};
+
+    // Must be called with the mutex held
+    void add(unsigned int index)
+    {
+        if(registered[index])
+        {
+            return;
+        }
+
+        ITCHyImplementation* device = devices[index]->impl;
+        if(!device->frames)
+        {
+            device->frames = new SPSCRing<ITCHy::State>(1024);
+        }
+        device->startBackground();
+        device->receiving = true;
+
+        impl* manager = this;
+        std::mutex* guard = &servicing[index];
+        device->release = [manager, guard, index]()
+        {
+            // The I/O thread already holds the guard of the device it services
+            std::unique_lock<std::mutex> serviced(*guard, std::defer_lock);
+            if(std::this_thread::get_id() != manager->io.get_id())
+            {
+                serviced.lock();
+            }
+
+            std::lock_guard<std::mutex> lock(manager->mutex);
+            manager->remove(index);
+        };
+
+        // Called by tryConnect(), e.g. when auto-connect brings the device back
+        device->reattach = [manager, index]()
+        {
+            std::lock_guard<std::mutex> lock(manager->mutex);
+            manager->add(index);
+        };
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u32 = index;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, transports[index]->descriptor(), &event);
+        registered[index] = true;
+
+        if(!running)
+        {
+            running = true;
+            io = std::thread([manager](){ manager->run(); });
+        }
+    }
+
+    // Must be called with the mutex held
+    void remove(unsigned int index)
+    {
+        if(registered[index])
+        {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, transports[index]->descriptor(), nullptr);
+            registered[index] = false;
+        }
+    }
+
+    void run()
+    {
+        epoll_event events[16];
+
+        while(running)
+        {
+            int n = epoll_wait(epoll, events, 16, -1);
+
+            for(int e = 0; e < n; e++)
+            {
+                uint32_t index = events[e].data.u32;
+                if(index == Wakeup)
+                {
+                    uint64_t value;
+                    ssize_t ret = read(wakeup, &value, sizeof(value));
+                    (void) ret;
+                    continue;
+                }
+
+                ITCHy* device;
+                std::mutex* guard;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    device = devices[index];
+                    guard = &servicing[index];
+                }
+
+                // The device may have been removed since epoll_wait() returned
+                std::lock_guard<std::mutex> serviced(*guard);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(!registered[index])
+                    {
+                        continue;
+                    }
+                }
+
+                // Read all reports buffered by the kernel
+                while(true)
+                {
+                    // All devices share the same host clock
+                    int num = device->impl->receiveBackground(0, [&](const ITCHy::State& state)
+                    {
+                        Frame* frame = frames.claim();
+                        if(frame)
+                        {
+                            frame->device = index;
+                            frame->state = state;
+                            frames.publish();
+                        }
+                    });
+
+                    if(num == 0)
+                    {
+                        break;
+                    }
+
+                    if(num < 0)
+                    {
+                        device->impl->callAll(ITCHy::CallbackType::CommunicationError);
+                        device->closeConnection();
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
+
+DeviceManager::DeviceManager() :
+    DeviceManager({0x16C0, 0x0486, 0xFFAB, 0x0200})
+{
+}
+
+DeviceManager::DeviceManager(DeviceIdentifier identifier)
+{
+    implementation = new impl;
+    implementation->identifier = identifier;
+    implementation->epoll = epoll_create1(EPOLL_CLOEXEC);
+    implementation->wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = impl::Wakeup;
+    epoll_ctl(implementation->epoll, EPOLL_CTL_ADD, implementation->wakeup, &event);
+}
+
+DeviceManager::~DeviceManager()
+{
+    if(implementation->running)
+    {
+        implementation->running = false;
+        uint64_t value = 1;
+        ssize_t ret = write(implementation->wakeup, &value, sizeof(value));
+        (void) ret;
+        implementation->io.join();
+    }
+
+    for(ITCHy* device : implementation->devices)
+    {
+        // Stops the hotplug thread, which may reattach the device
+        device->setAutoConnect(false);
+        device->impl->release = nullptr;
+        device->impl->reattach = nullptr;
+        delete device;
+    }
+
+    close(implementation->wakeup);
+    close(implementation->epoll);
+    delete implementation;
+}
+
+std::vector<std::string> DeviceManager::serialNumbers() const
+{
+    std::vector<std::string> serials;
+    for(const HIDRawTransport::DeviceInfo& device :
+        HIDRawTransport::enumerate(implementation->identifier))
+    {
+        serials.push_back(device.serial);
+    }
+
+    return serials;
+}
+
+int DeviceManager::open(const std::string& serial)
+{
+    std::unique_lock<std::mutex> lock(implementation->mutex);
+
+    // Reuse the instance of a device that has been opened before
+    for(unsigned int index = 0; index < implementation->serials.size(); index++)
+    {
+        if(implementation->serials[index] != serial)
+        {
+            continue;
+        }
+
+        if(implementation->registered[index])
+        {
+            return int(index);
+        }
+
+        // Registers the device again via reattach, which takes the mutex
+        ITCHy* device = implementation->devices[index];
+        lock.unlock();
+        return device->tryConnect() ? int(index) : -1;
+    }
+
+    HIDRawTransport* transport = new HIDRawTransport(serial);
+    ITCHy* device = new ITCHy(implementation->identifier, transport);
+    if(!device->tryConnect())
+    {
+        delete device;
+        return -1;
+    }
+
+    unsigned int index = implementation->devices.size();
+    implementation->devices.push_back(device);
+    implementation->transports.push_back(transport);
+    implementation->serials.push_back(serial);
+    implementation->registered.push_back(false);
+    implementation->servicing.emplace_back();
+    implementation->add(index);
+
+    return int(index);
+}
+
+ITCHy* DeviceManager::device(unsigned int index) const
+{
+    std::lock_guard<std::mutex> lock(implementation->mutex);
+    if(index >= implementation->devices.size())
+    {
+        return nullptr;
+    }
+
+    return implementation->devices[index];
+}
+
+unsigned int DeviceManager::deviceCount() const
+{
+    std::lock_guard<std::mutex> lock(implementation->mutex);
+    return implementation->devices.size();
+}
+
+std::vector<DeviceManager::Frame> DeviceManager::drainFrames()
+{
+    std::vector<Frame> frames;
+    implementation->frames.drain(frames);
+    return frames;
+}
@@ -0,0 +1,337 @@
+#include "itchy/transport.h"
+
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace
+{
+
+// Minimal HID report descriptor parser, see hid_parse_item in pjrc_rawhid.c.
+// Only the top-level usage page and usage are of interest.
+int parseItem(uint32_t& val, const uint8_t*& data, const uint8_t* end)
+{
+    const uint8_t* p = data;
+    const int table[4] = {0, 1, 2, 4};
+    int tag;
+    int len;
+
+    if(p >= end)
+    {
+        return -1;
+    }
+
+    if(p[0] == 0xFE) // Long item: prefix, data size, tag and data
+    {
+        if(p + 3 > end || p + p[1] + 3 > end)
+        {
+            return -1;
+        }
+        tag = p[2];
+        val = 0;
+        len = p[1] + 2;
+    }
+    else // Short item
+    {
+        tag = p[0] & 0xFC;
+        len = table[p[0] & 0x03];
+        if(p + len + 1 > end)
+        {
+            return -1;
+        }
+
+        switch(p[0] & 0x03)
+        {
+        case 3: val = p[1] | (p[2] << 8) | (p[3] << 16) | (uint32_t(p[4]) << 24); break;
+        case 2: val = p[1] | (p[2] << 8); break;
+        case 1: val = p[1]; break;
+        case 0: val = 0; break;
+        }
+    }
+
+    data += len + 1;
+    return tag;
+}
+
+// Reads vendor id, product id and serial number from sysfs
+bool readDeviceInfo(const std::string& node, int& vendor, int& product,
+                    std::string& serial)
+{
+    std::ifstream uevent("/sys/class/hidraw/" + node + "/device/uevent");
+    std::string line;
+    bool found = false;
+    while(std::getline(uevent, line))
+    {
+        // Format: HID_ID=<bus>:<vendor>:<product>
+        unsigned int bus, vid, pid;
+        if(line.compare(0, 7, "HID_ID=") == 0 &&
+           sscanf(line.c_str() + 7, "%x:%x:%x", &bus, &vid, &pid) == 3)
+        {
+            vendor = int(vid);
+            product = int(pid);
+            found = true;
+        }
+
+        if(line.compare(0, 9, "HID_UNIQ=") == 0)
+        {
+            serial = line.substr(9);
+        }
+    }
+
+    return found;
+}
+
+bool matchesUsage(const std::string& node, int usagePage, int usage)
+{
+    std::ifstream file("/sys/class/hidraw/" + node + "/device/report_descriptor",
+                       std::ios::binary);
+    std::vector<uint8_t> descriptor((std::istreambuf_iterator<char>(file)),
+                                    std::istreambuf_iterator<char>());
+    if(descriptor.size() < 2)
+    {
+        return false;
+    }
+
+    const uint8_t* p = descriptor.data();
+    const uint8_t* end = descriptor.data() + descriptor.size();
+    uint32_t val = 0;
+    uint32_t parsedUsagePage = 0;
+    uint32_t parsedUsage = 0;
+    int tag;
+    while((tag = parseItem(val, p, end)) >= 0)
+    {
+        if(tag == 4) parsedUsagePage = val;
+        if(tag == 8) parsedUsage = val;
+        if(parsedUsagePage && parsedUsage) break;
+    }
+
+    if(!parsedUsagePage || !parsedUsage)
+    {
+        return false;
+    }
+
+    return (usagePage <= 0 || int(parsedUsagePage) == usagePage) &&
+           (usage <= 0 || int(parsedUsage) == usage);
+}
+
+}
+
+
+std::vector<HIDRawTransport::DeviceInfo> HIDRawTransport::enumerate(
+        const DeviceIdentifier& identifier)
+{
+    std::vector<DeviceInfo> devices;
+
+    DIR* dir = opendir("/sys/class/hidraw");
+    if(!dir)
+    {
+        return devices;
+    }
+
+    while(dirent* entry = readdir(dir))
+    {
+        std::string node = entry->d_name;
+        if(node.compare(0, 6, "hidraw") != 0)
+        {
+            continue;
+        }
+
+        int vendor, product;
+        std::string serial;
+        if(!readDeviceInfo(node, vendor, product, serial))
+        {
+            continue;
+        }
+
+        if((identifier[0] > 0 && vendor != identifier[0]) ||
+           (identifier[1] > 0 && product != identifier[1]) ||
+           !matchesUsage(node, identifier[2], identifier[3]))
+        {
+            continue;
+        }
+
+        devices.push_back({"/dev/" + node, serial});
+    }
+    closedir(dir);
+
+    return devices;
+}
+
+
+struct HIDRawTransport::impl
+{
+    std::string serial;
+    int fd = -1;
+    int epoll = -1;
+};
+
+HIDRawTransport::HIDRawTransport(const std::string& serial)
+{
+    implementation = new impl;
+    implementation->serial = serial;
+}
+
+HIDRawTransport::~HIDRawTransport()
+{
+    close();
+    delete implementation;
+}
+
+bool HIDRawTransport::open(const DeviceIdentifier& identifier)
+{
+    if(isOpen())
+    {
+        return true;
+    }
+
+    int fd = -1;
+    for(const DeviceInfo& device : enumerate(identifier))
+    {
+        if(!implementation->serial.empty() &&
+           device.serial != implementation->serial)
+        {
+            continue;
+        }
+
+        fd = ::open(device.node.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if(fd >= 0)
+        {
+            break;
+        }
+    }
+
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if(epoll < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        if(epoll >= 0)
+        {
+            ::close(epoll);
+        }
+        ::close(fd);
+        return false;
+    }
+
+    implementation->fd = fd;
+    implementation->epoll = epoll;
+    return true;
+}
+
+void HIDRawTransport::close()
+{
+    if(implementation->epoll >= 0)
+    {
+        ::close(implementation->epoll);
+        implementation->epoll = -1;
+    }
+
+    if(implementation->fd >= 0)
+    {
+        ::close(implementation->fd);
+        implementation->fd = -1;
+    }
+}
+
+bool HIDRawTransport::isOpen() const
+{
+    return implementation->fd >= 0;
+}
+
+int HIDRawTransport::receive(char* buffer, int length, int timeout)
+{
+    if(implementation->fd < 0)
+    {
+        return -1;
+    }
+
+    while(true)
+    {
+        ssize_t ret = ::read(implementation->fd, buffer, length);
+        if(ret >= 0)
+        {
+            return int(ret);
+        }
+
+        if(errno == EINTR)
+        {
+            continue;
+        }
+
+        // Device removed or other I/O error
+        if(errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            return -1;
+        }
+
+        // No report buffered, wait for the next one
+        epoll_event event;
+        int n = epoll_wait(implementation->epoll, &event, 1, timeout);
+        if(n == 0 || (n < 0 && errno == EINTR))
+        {
+            return 0;
+        }
+
+        if(n < 0 || (event.events & (EPOLLERR | EPOLLHUP)))
+        {
+            return -1;
+        }
+
+        // Do not wait a second time on spurious wakeups
+        timeout = 0;
+    }
+}
+
+int HIDRawTransport::send(const char* buffer, int length, int timeout)
+{
+    // Writes to hidraw are synchronous within the kernel, the timeout
+    // is therefore handled by the USB subsystem
+    (void) timeout;
+
+    if(implementation->fd < 0)
+    {
+        return -1;
+    }
+
+    // The device does not use numbered reports, the first byte
+    // has to be zero and is not transmitted
+    char report[65];
+    if(length > 64)
+    {
+        length = 64;
+    }
+    report[0] = 0;
+    memcpy(report + 1, buffer, length);
+
+    ssize_t ret;
+    do
+    {
+        ret = ::write(implementation->fd, report, length + 1);
+    } while(ret < 0 && errno == EINTR);
+
+    if(ret < 0)
+    {
+        return (errno == EAGAIN) ? 0 : -1;
+    }
+
+    return ret > 0 ? int(ret) - 1 : 0;
+}
+
+int HIDRawTransport::descriptor() const
+{
+    return implementation->fd;
+}
@@ -0,0 +1,123 @@
+#include "hotplugmonitor.h"
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <ctime>
+#include <cstring>
+
+HotplugMonitor::HotplugMonitor()
+{
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0)
+    {
+        return;
+    }
+
+    if(inotify_add_watch(fd, "/dev", IN_CREATE | IN_ATTRIB | IN_DELETE | IN_MOVED_TO) < 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+HotplugMonitor::~HotplugMonitor()
+{
+    if(fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+bool HotplugMonitor::valid() const
+{
+    return fd >= 0;
+}
+
+int HotplugMonitor::descriptor() const
+{
+    return fd;
+}
+
+bool HotplugMonitor::wait(int timeout)
+{
+    if(fd < 0)
+    {
+        usleep((timeout < 0 || timeout > 10) ? 10000 : timeout * 1000);
+        return true;
+    }
+
+    // Events of unrelated nodes are skipped without extending the timeout
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while(true)
+    {
+        int remaining = timeout;
+        if(timeout >= 0)
+        {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int elapsed = int((now.tv_sec - start.tv_sec) * 1000 +
+                              (now.tv_nsec - start.tv_nsec) / 1000000);
+            remaining = timeout > elapsed ? timeout - elapsed : 0;
+        }
+
+        pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        int n = poll(&pfd, 1, remaining);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if(n <= 0)
+        {
+            return false;
+        }
+
+        if(readEvents())
+        {
+            return true;
+        }
+
+        if(remaining == 0)
+        {
+            return false;
+        }
+    }
+}
+
+bool HotplugMonitor::readEvents()
+{
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    bool changed = false;
+    alignas(inotify_event) char buffer[4096];
+    while(true)
+    {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if(length <= 0)
+        {
+            break;
+        }
+
+        for(char* p = buffer; p < buffer + length; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            if(event->len > 0 && strncmp(event->name, "hidraw", 6) == 0)
+            {
+                changed = true;
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    return changed;
+}
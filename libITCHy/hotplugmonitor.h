@@ -0,0 +1,33 @@
+#ifndef HOTPLUGMONITOR_H
+#define HOTPLUGMONITOR_H
+
+// Watches /dev for hidraw nodes being created, made accessible (udev
+// adjusting the permissions) or removed using inotify. The USB bus itself
+// is never scanned.
+class HotplugMonitor
+{
+public:
+    HotplugMonitor();
+    ~HotplugMonitor();
+
+    HotplugMonitor(const HotplugMonitor&) = delete;
+    HotplugMonitor& operator=(const HotplugMonitor&) = delete;
+
+    // False if inotify is not available
+    bool valid() const;
+
+    // Readable if events are pending, for use with poll/epoll
+    int descriptor() const;
+
+    // Blocks until a hidraw node changed or the timeout [ms] has passed,
+    // -1 waits forever. Falls back to sleeping if inotify is not available.
+    bool wait(int timeout);
+
+    // Consumes all pending events, returns true if a hidraw node changed
+    bool readEvents();
+
+private:
+    int fd = -1;
+};
+
+#endif // HOTPLUGMONITOR_H
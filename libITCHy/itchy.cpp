@@ -1,12 +1,14 @@
 #include "itchy/itchy.h"
+#include "itchy/transport.h"
+#include "itchyimplementation.h"
+#include "hotplugmonitor.h"
 
-extern "C" {
-#include "pjrc_rawhid.h"
-}
+#include <stddef.h>
 
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <unistd.h>
-#include <vector>
-#include <map>
+#include <chrono>
 
 template<typename T>
 unsigned int typeToBuffer(char* buffer,const T& type, unsigned int start=0, unsigned int typeLength=1) {
@@ -32,124 +34,255 @@ unsigned int bufferToType(const char* buffer, T& type, unsigned int start=0, uns
     return i;
 }
 
-class ITCHyImplementation
-{
-public:
-
-    enum USBOpCodes
-    {
-        Invalid = 0,
-        CalibrationData = 1,
-        SimulationData = 2,
-        SetColor = 3,
-        SaveConfig = 4,
-        Calibrate = 5
-    };
-
-    DeviceIdentifier identifier;
-    bool connected = false;
-
-    std::map<ITCHy::CallbackType,
-             std::vector<std::function<void()>>> callbacks;
-
-    void callAll(ITCHy::CallbackType type)
-    {
-        for(auto& fun : callbacks[type])
-        {
-            fun();
-        }
-    }
-
-    ITCHy::State lastState;
-};
+ITCHY_CHECK_REPORT_LAYOUT(ITCHy::State);
+static_assert(offsetof(ITCHy::State, hostTime) >= ITCHyProtocol::ReportSize,
+              "Host side fields must not overlap the report");
 
 ITCHy::ITCHy() :
     ITCHy({0x16C0, 0x0486, 0xFFAB, 0x0200})
 {
 }
 
-ITCHy::ITCHy(DeviceIdentifier identifier)
+ITCHy::ITCHy(DeviceIdentifier identifier) :
+    ITCHy(identifier, nullptr)
+{
+}
+
+ITCHy::ITCHy(DeviceIdentifier identifier, Transport* transport)
 {
     impl = new ITCHyImplementation();
 
     impl->identifier = identifier;
-    impl->lastState.leftSensor = {{0.0, 0.0}};
-    impl->lastState.rightSensor = {{0.0, 0.0}};
+    impl->transport = transport ? transport : new HIDRawTransport();
+
+    ITCHyImplementation* implementation = impl;
+    impl->writer = new CommandWriter(impl->transport, [implementation]()
+    {
+        implementation->statistics.addSendFailure();
+        implementation->callAll(CallbackType::CommunicationError);
+    });
 }
 
 ITCHy::~ITCHy()
 {
+    setAutoConnect(false);
+    if(impl->hotplug.joinable())
+    {
+        impl->hotplug.join();
+    }
+    if(impl->hotplugWakeup >= 0)
+    {
+        close(impl->hotplugWakeup);
+    }
+
+    stopReceiving();
+    impl->writer->stop();
+    impl->transport->close();
+    delete impl->writer;
+    delete impl->transport;
+    delete impl->frames;
     delete impl;
 }
 
 void ITCHy::connect()
 {
+    connect(-1);
+}
+
+bool ITCHy::connect(int timeout)
+{
+    if(tryConnect())
+    {
+        return true;
+    }
+
+    // Wait for hidraw nodes to appear instead of polling. The device may
+    // have appeared before the monitor has been set up.
+    HotplugMonitor monitor;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
     while(!tryConnect())
     {
-        usleep(10000);
+        int remaining = -1;
+        if(timeout >= 0)
+        {
+            remaining = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                deadline - std::chrono::steady_clock::now()).count());
+            if(remaining <= 0)
+            {
+                return false;
+            }
+        }
+
+        monitor.wait(remaining);
     }
+
+    return true;
 }
 
 bool ITCHy::tryConnect()
 {
+    // May be called by the hotplug thread and the user at the same time
+    std::lock_guard<std::recursive_mutex> lock(impl->connection);
+
     if(impl->connected)
     {
         return true;
     }
 
-    int ret = rawhid_open(1,
-                          impl->identifier[0], impl->identifier[1],
-                          impl->identifier[2], impl->identifier[3]);
-
     // Device not found
-    if(ret <= 0)
+    if(!impl->transport->open(impl->identifier))
     {
         return false;
     }
 
-    // Device found
+    // Device found, it may have been restarted in the meantime
+    impl->clock.reset();
+    impl->motion.reset();
+    impl->versioned = false;
+    impl->statistics.addConnection();
+    impl->writer->start();
+
+    // Resume background reception before the device is seen as connected
+    if(impl->reattach)
+    {
+        impl->reattach();
+    }
+    else if(impl->resumeCapacity > 0)
+    {
+        startReader(impl->resumeCapacity);
+    }
+
     impl->connected = true;
+
+    // The device starts with snapshot reports
+    if(impl->reportFormat != ReportFormat::Snapshot)
+    {
+        setReportFormatAsync(impl->reportFormat);
+    }
+
     impl->callAll(CallbackType::Connected);
     return true;
 }
 
 void ITCHy::disconnect()
 {
-    if(impl->connected)
-    {
-        rawhid_close(0);
-        impl->connected = false;
-        impl->callAll(CallbackType::Disconnected);
-    }
+    setAutoConnect(false);
+    closeConnection();
 }
 
-bool ITCHy::connected() const
+void ITCHy::closeConnection()
 {
-    return impl->connected;
+    // A receive error may race disconnect(), only one thread tears down.
+    // The other one must not wait for the lock: disconnect() waits in
+    // release() for the I/O thread to finish servicing the device.
+    if(impl->closing.exchange(true))
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(impl->connection);
+
+        std::function<void()> release;
+        release.swap(impl->release);
+        if(release)
+        {
+            release();
+        }
+
+        impl->stopReader();
+
+        if(impl->connected)
+        {
+            impl->writer->stop();
+            impl->transport->close();
+            impl->connected = false;
+            impl->callAll(CallbackType::Disconnected);
+        }
+    }
+
+    impl->closing = false;
+
+    // The device may already be back
+    impl->wakeHotplug();
 }
 
-bool ITCHy::setCalibrationParameters(const vec2f& target)
+void ITCHy::setAutoConnect(bool enabled)
 {
-    if(!impl->connected)
+    if(!enabled)
     {
-        return false;
+        impl->autoConnect = false;
+        impl->wakeHotplug();
+
+        // Called from within a callback on the hotplug thread
+        if(impl->hotplug.joinable() && impl->hotplug.get_id() != std::this_thread::get_id())
+        {
+            impl->hotplug.join();
+        }
+        return;
     }
 
-    char buffer[64] = {0};
-    int p = 0;
-    char opcode = ITCHyImplementation::CalibrationData;
-    p += typeToBuffer(buffer, opcode, p);
-    p += typeToBuffer(buffer, target[0], p, 2);
+    if(impl->autoConnect.exchange(true))
+    {
+        return;
+    }
 
-    int ret = rawhid_send(0, buffer, 64, 1000);
+    if(impl->hotplug.get_id() == std::this_thread::get_id())
+    {
+        return;
+    }
 
-    if(ret <= 0)
+    if(impl->hotplug.joinable())
     {
-        impl->callAll(CallbackType::CommunicationError);
-        return false;
+        impl->hotplug.join();
     }
 
-    return true;
+    if(impl->hotplugWakeup < 0)
+    {
+        impl->hotplugWakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    }
+
+    impl->hotplug = std::thread([this]()
+    {
+        HotplugMonitor monitor;
+
+        pollfd fds[2];
+        fds[0].fd = monitor.descriptor();
+        fds[0].events = POLLIN;
+        fds[1].fd = impl->hotplugWakeup;
+        fds[1].events = POLLIN;
+
+        while(impl->autoConnect)
+        {
+            if(!impl->connected)
+            {
+                tryConnect();
+            }
+
+            // Without inotify, fall back to checking once per second
+            poll(fds, 2, monitor.valid() ? -1 : 1000);
+
+            monitor.readEvents();
+            uint64_t value;
+            ssize_t ret = read(impl->hotplugWakeup, &value, sizeof(value));
+            (void) ret;
+        }
+    });
+}
+
+bool ITCHy::autoConnect() const
+{
+    return impl->autoConnect;
+}
+
+bool ITCHy::connected() const
+{
+    return impl->connected;
+}
+
+bool ITCHy::setCalibrationParameters(const vec2f& target)
+{
+    return setCalibrationParametersAsync(target).get();
 }
 
 bool ITCHy::setSimulationParameters(
@@ -159,137 +292,283 @@ bool ITCHy::setSimulationParameters(
         int updateRate
         )
 {
-    if(!impl->connected)
-    {
-        return false;
-    }
+    return setSimulationParametersAsync(mass, stiffness, damping, updateRate).get();
+}
 
-    char buffer[64] = {0};
+bool ITCHy::setColor(const color& cl)
+{
+    return setColorAsync(cl).get();
+}
+
+bool ITCHy::startCalibration()
+{
+    return startCalibrationAsync().get();
+}
+
+bool ITCHy::saveState()
+{
+    return saveStateAsync().get();
+}
+
+bool ITCHy::setReportFormat(ReportFormat reportFormat)
+{
+    return setReportFormatAsync(reportFormat).get();
+}
+
+std::future<bool> ITCHy::setCalibrationParametersAsync(const vec2f& target)
+{
+    CommandWriter::Command command = {{0}, 1000};
+    int p = 0;
+    char opcode = ITCHyProtocol::CalibrationData;
+    p += typeToBuffer(command.buffer, opcode, p);
+    p += typeToBuffer(command.buffer, target[0], p, 2);
+
+    return impl->submit(command);
+}
+
+std::future<bool> ITCHy::setSimulationParametersAsync(
+        float mass,
+        float stiffness,
+        float damping,
+        int updateRate
+        )
+{
+    CommandWriter::Command command = {{0}, 1000};
+    int p = 0;
+    char opcode = ITCHyProtocol::SimulationData;
+    p += typeToBuffer(command.buffer, opcode, p);
+    p += typeToBuffer(command.buffer, damping, p);
+    p += typeToBuffer(command.buffer, mass, p);
+    p += typeToBuffer(command.buffer, stiffness, p);
+    p += typeToBuffer(command.buffer, updateRate, p);
+
+    return impl->submit(command);
+}
+
+std::future<bool> ITCHy::setColorAsync(const color& cl)
+{
+    CommandWriter::Command command = {{0}, 50};
     int p = 0;
-    char opcode = ITCHyImplementation::SimulationData;
-    p += typeToBuffer(buffer, opcode, p);
-    p += typeToBuffer(buffer, damping, p);
-    p += typeToBuffer(buffer, mass, p);
-    p += typeToBuffer(buffer, stiffness, p);
-    p += typeToBuffer(buffer, updateRate, p);
+    char opcode = ITCHyProtocol::SetColor;
+    p += typeToBuffer(command.buffer, opcode, p);
+    p += typeToBuffer(command.buffer, cl[0], p, 3);
 
-    int ret = rawhid_send(0, buffer, 64, 1000);
+    return impl->submit(command);
+}
 
-    if(ret <= 0)
+std::future<bool> ITCHy::startCalibrationAsync()
+{
+    CommandWriter::Command command = {{0}, 1000};
+    int p = 0;
+    char opcode = ITCHyProtocol::Calibrate;
+    p += typeToBuffer(command.buffer, opcode, p);
+
+    return impl->submit(command);
+}
+
+std::future<bool> ITCHy::saveStateAsync()
+{
+    CommandWriter::Command command = {{0}, 1000};
+    int p = 0;
+    char opcode = ITCHyProtocol::SaveConfig;
+    p += typeToBuffer(command.buffer, opcode, p);
+
+    return impl->submit(command);
+}
+
+std::future<bool> ITCHy::setReportFormatAsync(ReportFormat reportFormat)
+{
+    impl->reportFormat = reportFormat;
+
+    CommandWriter::Command command = {{0}, 1000};
+    int p = 0;
+    char opcode = ITCHyProtocol::SetReportFormat;
+    char format = ITCHyProtocol::Snapshot;
+    switch(reportFormat)
     {
-        impl->callAll(CallbackType::CommunicationError);
-        return false;
+    case ReportFormat::Snapshot:
+        break;
+    case ReportFormat::MultiSample:
+        format = ITCHyProtocol::MultiSample;
+        break;
+    case ReportFormat::RawIncrements:
+        format = ITCHyProtocol::RawIncrements;
+        break;
     }
+    p += typeToBuffer(command.buffer, opcode, p);
+    p += typeToBuffer(command.buffer, format, p);
 
-    return true;
+    return impl->submit(command);
 }
 
-bool ITCHy::setColor(const color& cl)
+const ITCHy::State& ITCHy::currentState(unsigned int timeout)
 {
-    if(!impl->connected)
+    if(impl->receiving)
     {
-        return false;
+        impl->update();
+        return impl->latest->state;
     }
 
-    char buffer[64] = {0};
-    int p = 0;
-    char opcode = ITCHyImplementation::SetColor;
-    p += typeToBuffer(buffer, opcode, p);
-    p += typeToBuffer(buffer, cl[0], p, 3);
+    if(!impl->connected)
+    {
+        return impl->latest->state;
+    }
 
-    int ret = rawhid_send(0, buffer, 64, 50);
+    // USB Read
+    int num = impl->receiveSynchronous(static_cast<int>(timeout));
 
-    if(ret <= 0)
+    // Error
+    if(num < 0)
     {
         impl->callAll(CallbackType::CommunicationError);
-        return false;
+        closeConnection();
     }
 
-    return true;
+    return impl->latest->state;
 }
 
-bool ITCHy::startCalibration()
+bool ITCHy::startReceiving(unsigned int capacity)
 {
     if(!impl->connected)
     {
         return false;
     }
 
-    char buffer[64] = {0};
-    int p = 0;
-    char opcode = ITCHyImplementation::Calibrate;
-    p += typeToBuffer(buffer, opcode, p);
+    if(impl->receiving)
+    {
+        return true;
+    }
 
-    int ret = rawhid_send(0, buffer, 64, 1000);
+    startReader(capacity);
+    return true;
+}
 
+void ITCHy::startReader(unsigned int capacity)
+{
+    // Collect a previous reader thread that stopped on its own
+    impl->stopReader();
 
-    if(ret <= 0)
+    // Frames may still be drained from a ring of the same size
+    if(!impl->frames || impl->framesCapacity != capacity)
     {
-        impl->callAll(CallbackType::CommunicationError);
-        return false;
+        delete impl->frames;
+        impl->frames = new SPSCRing<State>(capacity);
+        impl->framesCapacity = capacity;
     }
+    impl->startBackground();
+    impl->resumeCapacity = capacity;
 
-    return true;
+    impl->receiving = true;
+    impl->readerRunning = true;
+    impl->reader = std::thread([this]()
+    {
+        while(impl->readerRunning)
+        {
+            int num = impl->receiveBackground(100);
+
+            if(num < 0)
+            {
+                impl->callAll(CallbackType::CommunicationError);
+                closeConnection();
+                break;
+            }
+        }
+    });
 }
 
-bool ITCHy::saveState()
+void ITCHy::stopReceiving()
 {
-    if(!impl->connected)
+    // Devices serviced by a DeviceManager keep receiving
+    if(impl->reattach)
     {
-        return false;
+        return;
     }
 
-    char buffer[64] = {0};
-    int p = 0;
-    char opcode = ITCHyImplementation::SaveConfig;
-    p += typeToBuffer(buffer, opcode, p);
+    impl->resumeCapacity = 0;
+    impl->stopReader();
+    impl->stopBackground();
+}
 
-    int ret = rawhid_send(0, buffer, 64, 1000);
+uint64_t ITCHy::frameCount() const
+{
+    return impl->frameCount.load(std::memory_order_acquire);
+}
 
+uint64_t ITCHy::hostTime(uint32_t deviceTime) const
+{
+    uint64_t host = 0;
+    impl->clock.toHost(deviceTime, host);
+    return host;
+}
 
-    if(ret <= 0)
-    {
-        impl->callAll(CallbackType::CommunicationError);
-        return false;
-    }
+ITCHy::ClockEstimate ITCHy::clockEstimate() const
+{
+    return impl->clock.estimate();
+}
 
-    return true;
+ITCHy::Statistics ITCHy::statistics() const
+{
+    return impl->statistics.snapshot();
 }
 
-const ITCHy::State& ITCHy::currentState(unsigned int timeout)
+ITCHy::State ITCHy::predictState(uint64_t hostTime, PredictionModel model)
 {
-    if(!impl->connected)
+    if(impl->receiving)
     {
-        return impl->lastState;
+        impl->update();
     }
 
-    union
-    {
-        State newState;
-        char buffer[64];
-    } data;
+    return impl->latest->motion.predict(hostTime, model);
+}
 
-    // USB Read
-    int num = rawhid_recv(0, data.buffer, 64, static_cast<int>(timeout));
+bool ITCHy::receiving() const
+{
+    return impl->receiving;
+}
 
-    // Error
-    if(num < 0)
+std::vector<ITCHy::State> ITCHy::drainStates()
+{
+    std::vector<State> states;
+    drainStates(states);
+    return states;
+}
+
+size_t ITCHy::drainStates(std::vector<State>& states)
+{
+    if(!impl->frames)
     {
-        impl->callAll(CallbackType::CommunicationError);
-        disconnect();
+        return 0;
     }
-    else
+
+    return impl->frames->drain(states);
+}
+
+size_t ITCHy::consumeStates(const std::function<void(const StateSpan&)>& consumer)
+{
+    if(!impl->frames)
     {
-        State newState = data.newState;
-        impl->lastState = newState;
+        return 0;
     }
 
-    return impl->lastState;
+    return impl->frames->consume([&](const State* first, size_t count, size_t stride)
+    {
+        consumer(StateSpan(first, count, stride));
+    });
 }
 
-
 void ITCHy::addCallback(
         CallbackType type, const std::function<void()>& callback)
 {
-    impl->callbacks[type].push_back(callback);
+    impl->callbacks[size_t(type)].push_back(callback);
+}
+
+void ITCHy::addCallback(const std::function<void(const State&)>& callback)
+{
+    impl->frameCallbacks.push_back(callback);
+}
+
+void ITCHy::setRecorder(SessionRecorder* recorder)
+{
+    impl->recorder = recorder;
+    impl->writer->setRecorder(recorder);
 }
@@ -0,0 +1,45 @@
+#ifndef DEVICEMANAGER_H
+#define DEVICEMANAGER_H
+
+#include "itchy.h"
+
+#include <string>
+#include <vector>
+
+// Drives multiple ITCHy devices from a single process. Each device gets its
+// own hidraw handle, all of them are serviced by one epoll driven I/O thread.
+class DeviceManager
+{
+public:
+    struct Frame
+    {
+        unsigned int device;    // Index as returned by open()
+        ITCHy::State state;
+    };
+
+    DeviceManager();
+    DeviceManager(DeviceIdentifier identifier);
+    ~DeviceManager();
+
+    // Serial numbers of all attached devices matching the identifier
+    std::vector<std::string> serialNumbers() const;
+
+    // Connects to the device with the given serial number and starts
+    // receiving its frames. Returns the device index or -1 on failure.
+    // Reconnected devices, e.g. by auto-connect, are serviced again.
+    int open(const std::string& serial);
+
+    // Devices are owned by the manager
+    ITCHy* device(unsigned int index) const;
+    unsigned int deviceCount() const;
+
+    // Frames of all devices received since the last call,
+    // ordered by host receive time
+    std::vector<Frame> drainFrames();
+
+private:
+    struct impl;
+    impl* implementation;
+};
+
+#endif // DEVICEMANAGER_H
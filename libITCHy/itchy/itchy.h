@@ -1,9 +1,12 @@
 #ifndef ITCHY_H
 #define ITCHY_H
 
+#include <cstddef>
 #include <cstdint>
 #include <array>
 #include <functional>
+#include <future>
+#include <vector>
 
 using DeviceIdentifier = std::array<int32_t, 4>;
 using vec2f = std::array<float, 2>;
@@ -12,10 +15,15 @@ using color = std::array<uint8_t, 3>;
 using byte = uint8_t;
 
 class ITCHyImplementation;
+class DeviceManager;
+class SessionRecorder;
 
 class ITCHy
 {
 public:
+    // Low level access to the device, see transport.h
+    class Transport;
+
     enum class CallbackType
     {
         // The device has been connected successfully
@@ -25,7 +33,10 @@ public:
         Disconnected,
 
         // An USB package was not received correctly
-        CommunicationError
+        CommunicationError,
+
+        // A frame has been received, called on the receiving thread
+        FrameReceived
     };
 
     struct State {
@@ -36,6 +47,11 @@ public:
         float angularVelocity;
         byte  button;
 
+        // Integrity (3 bytes, see protocol.h)
+        byte sequence;          // Frame counter, wraps around
+        byte version;           // Protocol version, 0 for old firmware
+        byte checksum;          // CRC-8 of the report
+
         // Raw sensor data (16 bytes)
         vec2f leftSensor;
         vec2f rightSensor;
@@ -48,20 +64,128 @@ public:
         float timeStep;
         float time;
 
-        // Unused
-        byte unused[7];
+        // Device clock (4 bytes)
+        uint32_t deviceTime;    // Microseconds since device start when sampled
+
+        // Host side information (not part of the USB report)
+        uint64_t hostTime;      // CLOCK_MONOTONIC receive time [ns]
+    };
+
+    // Extrapolation of the pose, see predictState()
+    enum class PredictionModel
+    {
+        ConstantVelocity,
+        ConstantAcceleration
+    };
+
+    // Read-only view of consecutive frames stored with the given distance
+    // in bytes, see consumeStates()
+    class StateSpan
+    {
+    public:
+        class iterator
+        {
+        public:
+            iterator(const char* p, size_t stride) : p(p), stride(stride) {}
+            const State& operator*() const { return *reinterpret_cast<const State*>(p); }
+            const State* operator->() const { return reinterpret_cast<const State*>(p); }
+            iterator& operator++() { p += stride; return *this; }
+            bool operator!=(const iterator& other) const { return p != other.p; }
+            bool operator==(const iterator& other) const { return p == other.p; }
+
+        private:
+            const char* p;
+            size_t stride;
+        };
+
+        StateSpan(const State* first, size_t count, size_t stride) :
+            first(reinterpret_cast<const char*>(first)), count(count), stride(stride) {}
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const State& operator[](size_t index) const
+        {
+            return *reinterpret_cast<const State*>(first + index * stride);
+        }
+        iterator begin() const { return iterator(first, stride); }
+        iterator end() const { return iterator(first + count * stride, stride); }
+
+    private:
+        const char* first;
+        size_t count;
+        size_t stride;
+    };
+
+    // See setReportFormat()
+    enum class ReportFormat
+    {
+        // One frame per report
+        Snapshot,
+
+        // Several simulation steps per report, with reduced precision and
+        // without raw sensor, debug and simulation data
+        MultiSample,
+
+        // Sensor increments only, to be simulated on the host, see Simulation
+        RawIncrements
+    };
+
+    // Relation between device and host clock, see clockEstimate()
+    struct ClockEstimate
+    {
+        bool   valid;
+        double offset;  // Host time [ns] minus device time [ns] at the latest frame
+        double drift;   // Rate difference of the host clock w.r.t. the device clock [ppm]
+    };
+
+    // Link health counters since construction, see statistics().
+    // Histogram bin 0 counts values below 1 us, bin n values in
+    // [2^(n-1), 2^n) us, the last bin everything above.
+    struct Statistics
+    {
+        static const size_t HistogramBins = 24;
+
+        uint64_t framesReceived;
+        uint64_t framesLost;        // Gaps in the sequence numbers or device time,
+                                    // skipped corrupted frames included. In
+                                    // MultiSample mode estimated from the frames
+                                    // of the report before the gap.
+        uint64_t reportsLost;       // The same in USB reports, exact with
+                                    // sequence numbers
+        uint64_t framesCorrupted;   // Failed the checksum, skipped
+        uint64_t receiveErrors;
+        uint64_t sendFailures;
+        uint64_t reconnects;
+
+        // Host receive time difference of consecutive frames
+        uint64_t intervalHistogram[HistogramBins];
+
+        // Host receive time minus the device sampling time mapped to the
+        // host clock, i.e. the delay above the lowest transfer delay seen
+        uint64_t latencyHistogram[HistogramBins];
     };
 
 public:
     ITCHy();
     ITCHy(DeviceIdentifier identifier);
+    // Takes ownership of the given transport, nullptr selects hidraw
+    ITCHy(DeviceIdentifier identifier, Transport* transport);
     ~ITCHy();
 
+    // Blocks until the device is connected. Instead of polling, hidraw
+    // nodes appearing in /dev are awaited (timeout in ms, -1 waits forever).
     void connect();
+    bool connect(int timeout);
     bool tryConnect();
+    // Also disables automatic reconnection
     void disconnect();
     bool connected() const;
 
+    // Connects automatically as soon as the device appears, e.g. after the
+    // cable has been reattached. Background reception is resumed.
+    void setAutoConnect(bool enabled);
+    bool autoConnect() const;
+
 
     bool setCalibrationParameters(const vec2f& target);
     bool setSimulationParameters(
@@ -74,12 +198,80 @@ public:
     bool startCalibration();
     bool saveState();
 
+    // Selects how the device packs frames into its reports. Multi-sample
+    // reports are split into individual frames, raising the frame rate by
+    // up to five times at the same report rate. Reapplied after reconnecting.
+    bool setReportFormat(ReportFormat reportFormat);
+
+    // Non-blocking variants: commands are sent by a writer thread in the
+    // order of submission. A pending color, simulation or calibration
+    // command is replaced by a newer one of the same kind, its future then
+    // reports the result of the newer one. The blocking calls above use the
+    // same queue and wait for the result.
+    std::future<bool> setCalibrationParametersAsync(const vec2f& target);
+    std::future<bool> setSimulationParametersAsync(
+            float mass,
+            float stiffness,
+            float damping,
+            int updateRate
+            );
+    std::future<bool> setColorAsync(const color& cl);
+    std::future<bool> startCalibrationAsync();
+    std::future<bool> saveStateAsync();
+    std::future<bool> setReportFormatAsync(ReportFormat reportFormat);
+
     const State& currentState(unsigned int timeout = 50);
 
+    // Number of frames received since construction
+    uint64_t frameCount() const;
+
+    // Maps a device time stamp (State::deviceTime) to host CLOCK_MONOTONIC
+    // time [ns] using a running estimate of clock offset and drift.
+    // Returns 0 if no estimate is available yet.
+    uint64_t hostTime(uint32_t deviceTime) const;
+    ClockEstimate clockEstimate() const;
+
+    // Snapshot of the link statistics. The counters are updated without
+    // locking, the snapshot is therefore not taken atomically as a whole.
+    Statistics statistics() const;
+
+    // Latest state with position and angle extrapolated to the given host
+    // CLOCK_MONOTONIC time [ns] for compensating the output latency.
+    // Does not wait for the device.
+    State predictState(uint64_t hostTime,
+                       PredictionModel model = PredictionModel::ConstantVelocity);
+
+    // Background reception: a reader thread owned by ITCHy receives all
+    // frames. currentState() then returns the newest frame without waiting,
+    // drainStates() returns all frames received since its last call.
+    bool startReceiving(unsigned int capacity = 1024);
+    void stopReceiving();
+    bool receiving() const;
+    std::vector<State> drainStates();
+    size_t drainStates(std::vector<State>& states);
+
+    // Passes the frames received since the last call without copying them.
+    // The spans are only valid during the call of the consumer, which may be
+    // called twice if the frames wrap around the end of the internal buffer.
+    size_t consumeStates(const std::function<void(const StateSpan&)>& consumer);
+
     void addCallback(CallbackType type, const std::function<void()>& callback);
 
+    // FrameReceived callback getting the freshly received frame. Runs on
+    // the thread receiving it and delays the next frame, keep it short.
+    void addCallback(const std::function<void(const State&)>& callback);
+
+    // Records all received frames and sent commands, see sessionrecorder.h.
+    // The recorder is not owned, nullptr stops recording.
+    void setRecorder(SessionRecorder* recorder);
+
 
 private:
+    // Disconnects without disabling automatic reconnection
+    void closeConnection();
+    void startReader(unsigned int capacity);
+
+    friend class DeviceManager;
     ITCHyImplementation* impl;
 };
 
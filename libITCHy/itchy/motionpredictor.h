@@ -0,0 +1,42 @@
+#ifndef MOTIONPREDICTOR_H
+#define MOTIONPREDICTOR_H
+
+#include "itchy.h"
+
+// Extrapolates the pose of the device to a given point in time.
+// Translational and angular velocities (and accelerations) are estimated
+// from consecutive frames: the velocity fields reported by the device are the
+// sum of both sensor velocities and are not suited for extrapolation.
+class MotionPredictor
+{
+public:
+    MotionPredictor();
+
+    void reset();
+
+    // sampleTime: time the frame has been sampled at, e.g. the device time
+    // mapped to host time [ns]
+    void addFrame(const ITCHy::State& state, uint64_t sampleTime);
+
+    bool valid() const;
+    const ITCHy::State& state() const;
+    uint64_t sampleTime() const;
+
+    // Returns the latest state with position and angle extrapolated to the
+    // given time [ns]. hostTime of the returned state is set to this time.
+    ITCHy::State predict(uint64_t time,
+                         ITCHy::PredictionModel model =
+                            ITCHy::PredictionModel::ConstantVelocity) const;
+
+private:
+    ITCHy::State last;
+    uint64_t lastTime;
+    unsigned int frames;
+
+    vec2f velocity;             // [m/s]
+    vec2f acceleration;         // [m/s^2]
+    float angularVelocity;      // [rad/s]
+    float angularAcceleration;  // [rad/s^2]
+};
+
+#endif // MOTIONPREDICTOR_H
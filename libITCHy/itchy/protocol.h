@@ -0,0 +1,172 @@
+#ifndef ITCHY_PROTOCOL_H
+#define ITCHY_PROTOCOL_H
+
+// Wire format of the 64 byte USB reports exchanged with the device.
+// Shared by libITCHy and the firmware (teensyHIDSimulator), both check their
+// report structs against it at compile time using ITCHY_CHECK_REPORT_LAYOUT.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits>
+
+namespace ITCHyProtocol
+{
+
+const size_t ReportSize = 64;
+
+// Byte offsets of the fields within a device report
+namespace Offset
+{
+const size_t Position = 0;
+const size_t Angle = 8;
+const size_t Velocity = 12;
+const size_t AngularVelocity = 20;
+const size_t Button = 24;
+const size_t Sequence = 25;
+const size_t Version = 26;
+const size_t Checksum = 27;
+const size_t LeftSensor = 28;
+const size_t RightSensor = 36;
+const size_t LeftIncrement = 44;
+const size_t RightIncrement = 48;
+const size_t TimeStep = 52;
+const size_t Time = 56;
+const size_t DeviceTime = 60;
+
+// Multi-sample reports: SubSamples entries replace the sensor, debug and
+// simulation fields
+const size_t SubSample = 28;
+}
+
+// Device reports carry a protocol version in the lower nibble of the version
+// byte and the report format in the upper one. Reports of firmware without
+// a version have 0 in its place and are not checked.
+const uint8_t ProtocolVersion = 1;
+
+enum ReportFormat
+{
+    // One frame per report
+    Snapshot = 0x00,
+
+    // The newest frame (position, angle, velocities, button, device time)
+    // preceded by up to SubSamples older simulation steps since the last
+    // report, stored relative to the newest one
+    MultiSample = 0x10,
+
+    // No simulation on the device: the calibrated increments of both sensors
+    // since the last report, to be simulated on the host (see Simulation)
+    RawIncrements = 0x20
+};
+
+const size_t SubSamples = 4;
+
+struct SubSample
+{
+    int16_t position[2];    // Relative to the newest frame [SubSamplePositionScale m]
+    int16_t angle;          // Relative to the newest frame [SubSampleAngleScale rad]
+    uint16_t age;           // Time before the newest frame [us], 0 marks unused entries
+};
+
+const float SubSamplePositionScale = 1.0e-6f;
+const float SubSampleAngleScale = 1.0e-4f;
+
+static_assert(sizeof(SubSample) == 8, "SubSample");
+static_assert(Offset::SubSample + SubSamples * sizeof(SubSample) <= Offset::DeviceTime,
+              "Sub-samples overlap the device time");
+
+// Raw increment reports: the left and right sensor fields hold the
+// increments in the frame of the device [m], timeStep the time they cover
+// [s] and the button byte the following flags
+enum RawFlag
+{
+    RawButton = 0x01,       // Thumb button pressed
+    RawReset = 0x02,        // Simulation reset on the device before the increments
+    RawLifted = 0x04        // A sensor has been lifted after the increments
+};
+
+inline ReportFormat format(const char* report)
+{
+    return ReportFormat(uint8_t(report[Offset::Version]) & 0xF0);
+}
+
+// CRC-8 (polynomial 0x07, SMBus) over a device report, the checksum byte
+// itself taken as 0. Processed a nibble at a time to keep the table small.
+inline uint8_t checksum(const char* report)
+{
+    static const uint8_t table[16] = {
+        0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+        0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+    };
+
+    uint8_t crc = 0;
+    for(size_t n = 0; n < ReportSize; n++)
+    {
+        crc ^= (n == Offset::Checksum) ? 0 : uint8_t(report[n]);
+        crc = uint8_t(crc << 4) ^ table[crc >> 4];
+        crc = uint8_t(crc << 4) ^ table[crc >> 4];
+    }
+
+    return crc;
+}
+
+// Device side: sets sequence number, version and checksum of a report
+inline void seal(char* report, uint8_t sequence, ReportFormat reportFormat = Snapshot)
+{
+    report[Offset::Sequence] = char(sequence);
+    report[Offset::Version] = char(ProtocolVersion | reportFormat);
+    report[Offset::Checksum] = char(checksum(report));
+}
+
+// Host side: false if the report has been corrupted in transfer. Reports of
+// former firmware carry no version and checksum. Once versioned reports have
+// been seen on a connection (versioned), a zero version byte is corrupted.
+inline bool valid(const char* report, bool versioned = false)
+{
+    if(report[Offset::Version] == 0)
+    {
+        return !versioned;
+    }
+
+    return uint8_t(report[Offset::Checksum]) == checksum(report);
+}
+
+// First byte of a host report
+enum OpCode
+{
+    Invalid = 0,
+    CalibrationData = 1,
+    SimulationData = 2,
+    SetColor = 3,
+    SaveConfig = 4,
+    Calibrate = 5,
+    SetReportFormat = 6     // Followed by a ReportFormat byte
+};
+
+}
+
+// Reports are reinterpreted in place, which requires the same representation
+// on both sides
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "The ITCHy report format requires a little endian target");
+static_assert(std::numeric_limits<float>::is_iec559 && sizeof(float) == 4,
+              "The ITCHy report format requires IEEE 754 single precision floats");
+
+#define ITCHY_CHECK_REPORT_LAYOUT(Type) \
+    static_assert(sizeof(Type) >= ITCHyProtocol::ReportSize, #Type " is smaller than a report"); \
+    static_assert(offsetof(Type, position) == ITCHyProtocol::Offset::Position, #Type "::position"); \
+    static_assert(offsetof(Type, angle) == ITCHyProtocol::Offset::Angle, #Type "::angle"); \
+    static_assert(offsetof(Type, velocity) == ITCHyProtocol::Offset::Velocity, #Type "::velocity"); \
+    static_assert(offsetof(Type, angularVelocity) == ITCHyProtocol::Offset::AngularVelocity, #Type "::angularVelocity"); \
+    static_assert(offsetof(Type, button) == ITCHyProtocol::Offset::Button, #Type "::button"); \
+    static_assert(offsetof(Type, sequence) == ITCHyProtocol::Offset::Sequence, #Type "::sequence"); \
+    static_assert(offsetof(Type, version) == ITCHyProtocol::Offset::Version, #Type "::version"); \
+    static_assert(offsetof(Type, checksum) == ITCHyProtocol::Offset::Checksum, #Type "::checksum"); \
+    static_assert(offsetof(Type, leftSensor) == ITCHyProtocol::Offset::LeftSensor, #Type "::leftSensor"); \
+    static_assert(offsetof(Type, rightSensor) == ITCHyProtocol::Offset::RightSensor, #Type "::rightSensor"); \
+    static_assert(offsetof(Type, leftIncrement) == ITCHyProtocol::Offset::LeftIncrement, #Type "::leftIncrement"); \
+    static_assert(offsetof(Type, rightIncrement) == ITCHyProtocol::Offset::RightIncrement, #Type "::rightIncrement"); \
+    static_assert(offsetof(Type, timeStep) == ITCHyProtocol::Offset::TimeStep, #Type "::timeStep"); \
+    static_assert(offsetof(Type, time) == ITCHyProtocol::Offset::Time, #Type "::time"); \
+    static_assert(offsetof(Type, deviceTime) == ITCHyProtocol::Offset::DeviceTime, #Type "::deviceTime")
+
+#endif // ITCHY_PROTOCOL_H
@@ -0,0 +1,91 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include "itchy.h"
+#include "protocol.h"
+
+#include <string>
+
+// Recordings consist of a fixed header followed by fixed size records in
+// the order of recording. As records have the same size and increasing
+// host times, the records themselves serve as time index: any point in
+// time can be found by binary search, see SessionReader::seek().
+struct SessionHeader
+{
+    char     magic[8];          // "ITCHYREC"
+    uint32_t version;
+    uint32_t headerSize;        // Offset of the first record [bytes]
+    uint32_t recordSize;        // [bytes]
+    uint32_t reserved;
+    uint64_t startTime;         // Host CLOCK_MONOTONIC time [ns] at creation
+    uint64_t recordCount;       // Updated after every record
+};
+
+struct SessionRecord
+{
+    enum Type : uint32_t
+    {
+        Frame = 1,      // Report received from the device
+        Command = 2     // Command sent to the device
+    };
+
+    uint64_t hostTime;          // CLOCK_MONOTONIC [ns]
+    uint32_t type;
+    uint32_t reserved;
+    char     payload[ITCHyProtocol::ReportSize];
+};
+
+// Append-only, memory mapped recording of a session. The file grows in
+// chunks, a crash leaves all records up to recordCount intact.
+// Records may be added from multiple threads.
+class SessionRecorder
+{
+public:
+    SessionRecorder();
+    ~SessionRecorder();
+
+    bool open(const std::string& fileName);
+    void close();
+    bool isOpen() const;
+
+    // Frames are recorded with their receive time, commands with the
+    // current time. A frame received before a command recorded earlier
+    // gets the time of that command, so host times never decrease.
+    void recordFrame(const ITCHy::State& state);
+    void recordCommand(const char* buffer);
+
+    uint64_t recordCount() const;
+
+private:
+    struct impl;
+    impl* implementation;
+};
+
+// Read-only access to a recording
+class SessionReader
+{
+public:
+    SessionReader();
+    ~SessionReader();
+
+    bool open(const std::string& fileName);
+    void close();
+    bool isOpen() const;
+
+    const SessionHeader& header() const;
+    uint64_t recordCount() const;
+    const SessionRecord& record(uint64_t index) const;
+
+    // Index of the first record at or after the given host time [ns]
+    uint64_t seek(uint64_t hostTime) const;
+
+    // Frame records decoded into a state, hostTime is set to the recorded
+    // receive time
+    static ITCHy::State frame(const SessionRecord& record);
+
+private:
+    struct impl;
+    impl* implementation;
+};
+
+#endif // SESSIONRECORDER_H
@@ -0,0 +1,91 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "itchy.h"
+
+#include <vector>
+
+// Host side counterpart of the spring-damper model of the firmware, driven by
+// the sensor increments of RawIncrements reports (see ITCHy::setReportFormat()).
+// Any number of variants with different parameters are advanced side by side
+// from the same increments. Their state is kept as a structure of arrays, so
+// the updates of all variants vectorize.
+class Simulation
+{
+public:
+    enum class Integrator
+    {
+        SymplecticEuler,
+        VelocityVerlet,     // As used by the firmware
+        RungeKutta4
+    };
+
+    struct Parameters
+    {
+        float mass;         // [kg]
+        float stiffness;    // [N/m]
+        float damping;      // [Ns/m]
+    };
+
+    explicit Simulation(Integrator integrator = Integrator::VelocityVerlet);
+
+    // Returns the index of the new variant, which starts at the initial pose
+    size_t addVariant(const Parameters& parameters);
+    size_t variants() const;
+
+    // Takes effect with the next step, the variant is not reset
+    void setParameters(size_t variant, const Parameters& parameters);
+    const Parameters& parameters(size_t variant) const;
+
+    void setIntegrator(Integrator integrator);
+    Integrator integrator() const;
+
+    // Simulation steps per second, the increments of a report are spread
+    // evenly over the steps in between. 0 (default) steps once per report.
+    void setStepRate(float rate);
+
+    // Moves all variants back to the initial pose
+    void reset();
+
+    // Advances all variants by the increments of a RawIncrements report,
+    // applying resets and lifts flagged by the device.
+    // Returns false (and does nothing) for reports of other formats.
+    bool update(const ITCHy::State& report);
+
+    // Advances all variants by one step of dt [s], left and right are the
+    // sensor increments in the frame of the device [m]
+    void step(const vec2f& left, const vec2f& right, float dt);
+
+    // Pose of a variant as a Snapshot report: position, angle, velocities,
+    // sensor positions and simulation time. Button and times are taken from
+    // the last report passed to update().
+    ITCHy::State state(size_t variant) const;
+
+private:
+    void initialize(size_t variant);
+    void lift();
+
+    Integrator method;
+    float stepRate;
+    float time;
+    float timeStep;
+    ITCHy::State last;
+
+    std::vector<Parameters> settings;
+
+    // Per variant, index 0 and 1 are the x and y components of the left
+    // sensor, 2 and 3 those of the right one
+    std::vector<float> anchor[4];       // Rigid body following the sensors
+    std::vector<float> point[4];        // Spring-damper end points
+    std::vector<float> velocity[4];
+
+    std::vector<float> inverseMass;
+    std::vector<float> stiffness;
+    std::vector<float> damping;
+
+    std::vector<float> cosAngle;
+    std::vector<float> sinAngle;
+    std::vector<float> angle;
+};
+
+#endif // SIMULATION_H
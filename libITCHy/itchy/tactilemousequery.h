@@ -2,11 +2,15 @@
 #define TACTILEMOUSEQUERY_H
 
 #include <scratchy/positionquery.h>
+#include "itchy.h"
+#include <chrono>
 
 class TactileMouseQuery : public PositionQuery
 {
 public:
     TactileMouseQuery(bool detached = false, unsigned int timeout = 50);
+    // Uses the given transport (e.g. ReplayTransport) and takes ownership
+    TactileMouseQuery(ITCHy::Transport* transport, bool detached = false, unsigned int timeout = 50);
     virtual ~TactileMouseQuery();
 
     // Implementations of PositionQuery interface:
@@ -20,6 +24,26 @@ public:
     virtual bool initialize();
     virtual void feedback(unsigned char r, unsigned char g, unsigned char b);
 
+    // Detached mode: blocks until a frame newer than the one fetched by the
+    // last update() is available or the deadline has passed.
+    // Returns true if update() will provide a new frame.
+    bool waitForUpdate(std::chrono::steady_clock::time_point deadline);
+
+    // Detached mode: eventfd that becomes readable when a frame newer than
+    // the one fetched by the last update() is available, e.g. for select()
+    // or event loops. update() resets it. Returns -1 in attached mode.
+    int descriptor();
+
+    // Link statistics of the device, see ITCHy::statistics()
+    ITCHy::Statistics statistics() const;
+
+    // Pose extrapolated dt seconds from now, based on the frames up to the
+    // one fetched by the last update()
+    QVector2D predictedPosition(float dt,
+            ITCHy::PredictionModel model = ITCHy::PredictionModel::ConstantVelocity) const;
+    float predictedOrientation(float dt,
+            ITCHy::PredictionModel model = ITCHy::PredictionModel::ConstantVelocity) const;
+
 private:
     struct impl;
     impl* implementation;    
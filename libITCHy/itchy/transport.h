@@ -0,0 +1,137 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "itchy.h"
+
+#include <string>
+#include <vector>
+
+// Interface between ITCHy and the USB device. All calls follow the semantics
+// of the pjrc rawhid functions: receive and send return the number of bytes
+// transferred, 0 on timeout or -1 on error.
+class ITCHy::Transport
+{
+public:
+    virtual ~Transport() {}
+
+    virtual bool open(const DeviceIdentifier& identifier) = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+
+    virtual int receive(char* buffer, int length, int timeout) = 0;
+    virtual int send(const char* buffer, int length, int timeout) = 0;
+
+    // File descriptor that becomes readable if a report is pending,
+    // -1 if not supported by the backend
+    virtual int descriptor() const { return -1; }
+};
+
+
+// Kernel hidraw backend (default). Reports are buffered by the kernel and
+// read non-blocking, waiting on an epoll instance if no report is pending.
+// If a serial number is given, only the device with this serial is opened.
+class HIDRawTransport : public ITCHy::Transport
+{
+public:
+    struct DeviceInfo
+    {
+        std::string node;       // e.g. /dev/hidraw3
+        std::string serial;
+    };
+
+    // Lists all devices matching the identifier without opening them
+    static std::vector<DeviceInfo> enumerate(const DeviceIdentifier& identifier);
+
+    HIDRawTransport(const std::string& serial = std::string());
+    virtual ~HIDRawTransport();
+
+    virtual bool open(const DeviceIdentifier& identifier);
+    virtual void close();
+    virtual bool isOpen() const;
+
+    virtual int receive(char* buffer, int length, int timeout);
+    virtual int send(const char* buffer, int length, int timeout);
+
+    virtual int descriptor() const;
+
+private:
+    struct impl;
+    impl* implementation;
+};
+
+
+// libusb 0.1 backend using the pjrc rawhid functions.
+// Only a single device per process is supported.
+class LibUSBTransport : public ITCHy::Transport
+{
+public:
+    LibUSBTransport();
+    virtual ~LibUSBTransport();
+
+    virtual bool open(const DeviceIdentifier& identifier);
+    virtual void close();
+    virtual bool isOpen() const;
+
+    virtual int receive(char* buffer, int length, int timeout);
+    virtual int send(const char* buffer, int length, int timeout);
+
+private:
+    bool opened = false;
+};
+
+
+// In-process device replacement, e.g. for testing and benchmarking
+// without hardware. Reports pushed by the "device" side are received by
+// ITCHy, commands sent by ITCHy can be fetched using popCommand.
+class LoopbackTransport : public ITCHy::Transport
+{
+public:
+    LoopbackTransport();
+    virtual ~LoopbackTransport();
+
+    virtual bool open(const DeviceIdentifier& identifier);
+    virtual void close();
+    virtual bool isOpen() const;
+
+    virtual int receive(char* buffer, int length, int timeout);
+    virtual int send(const char* buffer, int length, int timeout);
+
+    // Device side
+    void pushReport(const char* buffer, int length);
+    int popCommand(char* buffer, int length, int timeout);
+
+private:
+    struct impl;
+    impl* implementation;
+};
+
+
+
+// Feeds a recording (see sessionrecorder.h) back to ITCHy. Frames are
+// delivered with their recorded timing scaled by 1 / speed, a speed of 0
+// delivers them as fast as possible. Commands sent are discarded.
+class ReplayTransport : public ITCHy::Transport
+{
+public:
+    ReplayTransport(const std::string& fileName, double speed = 1.0);
+    virtual ~ReplayTransport();
+
+    virtual bool open(const DeviceIdentifier& identifier);
+    virtual void close();
+    virtual bool isOpen() const;
+
+    virtual int receive(char* buffer, int length, int timeout);
+    virtual int send(const char* buffer, int length, int timeout);
+
+    // Continues with the first frame recorded at or after the given time
+    void seek(uint64_t hostTime);
+
+    // True after the last frame has been received
+    bool finished() const;
+
+private:
+    struct impl;
+    impl* implementation;
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,408 @@
+#ifndef ITCHYIMPLEMENTATION_H
+#define ITCHYIMPLEMENTATION_H
+
+#include "itchy/itchy.h"
+#include "itchy/motionpredictor.h"
+#include "itchy/protocol.h"
+#include "itchy/sessionrecorder.h"
+#include "itchy/transport.h"
+#include "clockestimator.h"
+#include "commandwriter.h"
+#include "linkstatistics.h"
+#include "spscring.h"
+#include "triplebuffer.h"
+
+#include <array>
+#include <cstring>
+#include <ctime>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+class ITCHyImplementation
+{
+public:
+
+    DeviceIdentifier identifier;
+    ITCHy::Transport* transport = nullptr;
+    std::atomic<bool> connected{false};
+    std::recursive_mutex connection;
+
+    // Set by the thread tearing the connection down, see closeConnection()
+    std::atomic<bool> closing{false};
+
+    // Hotplug handling, see ITCHy::setAutoConnect()
+    std::thread hotplug;
+    std::atomic<bool> autoConnect{false};
+    int hotplugWakeup = -1;
+
+    // Background reception is resumed after reconnecting if non-zero
+    std::atomic<unsigned int> resumeCapacity{0};
+
+    void wakeHotplug()
+    {
+        if(hotplugWakeup >= 0)
+        {
+            uint64_t value = 1;
+            ssize_t ret = write(hotplugWakeup, &value, sizeof(value));
+            (void) ret;
+        }
+    }
+
+    static const size_t CallbackTypes = size_t(ITCHy::CallbackType::FrameReceived) + 1;
+
+    // Indexed by CallbackType
+    std::array<std::vector<std::function<void()>>, CallbackTypes> callbacks;
+    std::vector<std::function<void(const ITCHy::State&)>> frameCallbacks;
+
+    void callAll(ITCHy::CallbackType type)
+    {
+        for(auto& fun : callbacks[size_t(type)])
+        {
+            fun();
+        }
+    }
+
+    void frameReceived(const ITCHy::State& state)
+    {
+        for(auto& fun : frameCallbacks)
+        {
+            fun(state);
+        }
+        callAll(ITCHy::CallbackType::FrameReceived);
+    }
+
+    // Outbound commands are sent by the writer thread
+    CommandWriter* writer = nullptr;
+
+    std::future<bool> submit(const CommandWriter::Command& command)
+    {
+        if(!connected)
+        {
+            return result(false);
+        }
+
+        // Commands issued by callbacks running on the writer thread
+        if(writer->isWriterThread())
+        {
+            if(SessionRecorder* sessionRecorder = recorder.load())
+            {
+                sessionRecorder->recordCommand(command.buffer);
+            }
+
+            bool success = transport->send(command.buffer, ITCHyProtocol::ReportSize,
+                                           command.timeout) > 0;
+            if(!success)
+            {
+                statistics.addSendFailure();
+                callAll(ITCHy::CallbackType::CommunicationError);
+            }
+
+            return result(success);
+        }
+
+        return writer->submit(command);
+    }
+
+    static std::future<bool> result(bool value)
+    {
+        std::promise<bool> promise;
+        promise.set_value(value);
+        return promise.get_future();
+    }
+
+    // Latest frame along with the motion estimated up to it
+    struct Latest
+    {
+        ITCHy::State state;
+        MotionPredictor motion;
+    };
+
+    // Frames are decoded in place. Synchronous reception alternates between
+    // two frames, latest points to the one returned to the consumer.
+    Latest synchronous[2] = {};
+    unsigned int current = 0;
+    const Latest* latest = &synchronous[0];
+    std::atomic<uint64_t> frameCount{0};
+
+    // Background reception, either by the own reader thread or by the
+    // I/O thread of a DeviceManager
+    std::atomic<bool> receiving{false};
+    std::thread reader;
+    std::atomic<bool> readerRunning{false};
+    SPSCRing<ITCHy::State>* frames = nullptr;
+    unsigned int framesCapacity = 0;
+    ITCHy::State overflow;
+    TripleBuffer<Latest> latestFrame;
+
+    // Set by DeviceManager, removes the device from its I/O thread and
+    // registers it again after reconnecting
+    std::function<void()> release;
+    std::function<void()> reattach;
+
+    // Host receive time [ns]
+    static uint64_t hostTime()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return uint64_t(now.tv_sec) * 1000000000ull + uint64_t(now.tv_nsec);
+    }
+
+    ClockEstimator clock;
+
+    // See ITCHy::statistics()
+    LinkStatistics statistics;
+
+    // Versioned reports have been received since connecting, see
+    // ITCHyProtocol::valid(). Receiving thread only.
+    bool versioned = false;
+
+    // Updated by the thread receiving the frames
+    MotionPredictor motion;
+
+    // See ITCHy::setRecorder()
+    std::atomic<SessionRecorder*> recorder{nullptr};
+
+    // Adds the host receive time to a freshly received frame
+    void stamp(ITCHy::State& state, uint64_t received)
+    {
+        state.hostTime = received;
+
+        // Prefer the sampling time over the receive time for prediction
+        uint64_t sampleTime = 0;
+        if(state.deviceTime != 0)
+        {
+            clock.addSample(state.deviceTime, state.hostTime);
+            clock.toHost(state.deviceTime, sampleTime);
+        }
+
+        statistics.addFrame(state, sampleTime);
+        motion.addFrame(state, sampleTime ? sampleTime : state.hostTime);
+
+        if(SessionRecorder* sessionRecorder = recorder.load())
+        {
+            sessionRecorder->recordFrame(state);
+        }
+    }
+
+    // See ITCHy::setReportFormat(), reapplied after reconnecting
+    std::atomic<ITCHy::ReportFormat> reportFormat{ITCHy::ReportFormat::Snapshot};
+
+    static const size_t MaxFramesPerReport = ITCHyProtocol::SubSamples + 1;
+
+    static bool multiSample(const ITCHy::State& report)
+    {
+        return ITCHyProtocol::format(reinterpret_cast<const char*>(&report)) ==
+               ITCHyProtocol::MultiSample;
+    }
+
+    // Splits a multi-sample report into snapshot frames, oldest first.
+    // Sub-samples carry the velocities of the newest frame, the button
+    // state is reported with the newest frame only.
+    static size_t unpack(const ITCHy::State& report, ITCHy::State* frames)
+    {
+        ITCHy::State frame = ITCHy::State();
+        frame.velocity = report.velocity;
+        frame.angularVelocity = report.angularVelocity;
+
+        size_t count = 0;
+        for(size_t n = 0; n < ITCHyProtocol::SubSamples; n++)
+        {
+            ITCHyProtocol::SubSample sample;
+            memcpy(&sample, reinterpret_cast<const char*>(&report) + ITCHyProtocol::Offset::SubSample +
+                   n * sizeof(sample), sizeof(sample));
+            if(sample.age == 0)
+            {
+                continue;
+            }
+
+            for(int i = 0; i < 2; i++)
+            {
+                frame.position[i] = report.position[i] +
+                                    sample.position[i] * ITCHyProtocol::SubSamplePositionScale;
+            }
+            frame.angle = report.angle + sample.angle * ITCHyProtocol::SubSampleAngleScale;
+            frame.deviceTime = report.deviceTime - sample.age;
+            frames[count++] = frame;
+        }
+
+        frame.position = report.position;
+        frame.angle = report.angle;
+        frame.button = report.button;
+        frame.deviceTime = report.deviceTime;
+        frames[count++] = frame;
+
+        // Frames remain valid reports, e.g. for recording and replaying
+        for(size_t n = 0; n < count; n++)
+        {
+            ITCHyProtocol::seal(reinterpret_cast<char*>(&frames[n]), report.sequence);
+        }
+
+        return count;
+    }
+
+    int receiveReport(ITCHy::State& state, int timeout)
+    {
+        int num = transport->receive(reinterpret_cast<char*>(&state),
+                                     ITCHyProtocol::ReportSize, timeout);
+        if(num < 0)
+        {
+            statistics.addReceiveError();
+        }
+
+        // Corrupted frames are skipped
+        const char* report = reinterpret_cast<const char*>(&state);
+        if(num > 0 && !ITCHyProtocol::valid(report, versioned))
+        {
+            statistics.addCorruptedFrame();
+            return 0;
+        }
+
+        if(num > 0 && report[ITCHyProtocol::Offset::Version] != 0)
+        {
+            versioned = true;
+        }
+
+        return num;
+    }
+
+    // Synchronous reception into the spare frame
+    int receiveSynchronous(int timeout)
+    {
+        Latest* next = &synchronous[1 - current];
+        int num = receiveReport(next->state, timeout);
+        if(num <= 0)
+        {
+            return num;
+        }
+
+        uint64_t received = hostTime();
+        if(!multiSample(next->state))
+        {
+            publishSynchronous(received);
+            return num;
+        }
+
+        ITCHy::State samples[MaxFramesPerReport];
+        size_t count = unpack(next->state, samples);
+        for(size_t n = 0; n < count; n++)
+        {
+            synchronous[1 - current].state = samples[n];
+            publishSynchronous(received);
+        }
+
+        return num;
+    }
+
+    void publishSynchronous(uint64_t received)
+    {
+        Latest& next = synchronous[1 - current];
+        stamp(next.state, received);
+        next.motion = motion;
+        current = 1 - current;
+        latest = &next;
+        frameCount.fetch_add(1, std::memory_order_release);
+        frameReceived(next.state);
+    }
+
+    // Background reception in place into the next ring slot. Frames are
+    // dropped from the ring if the consumer is late, the latest frame is
+    // always available. Each received frame is passed to received(state).
+    template<typename F>
+    int receiveBackground(int timeout, F received)
+    {
+        ITCHy::State* slot = frames->claim();
+        ITCHy::State& frame = slot ? *slot : overflow;
+
+        int num = receiveReport(frame, timeout);
+        if(num <= 0)
+        {
+            return num;
+        }
+
+        uint64_t receiveTime = hostTime();
+        if(!multiSample(frame))
+        {
+            publishBackground(frame, slot != nullptr, receiveTime);
+            received(frame);
+            return num;
+        }
+
+        ITCHy::State samples[MaxFramesPerReport];
+        size_t count = unpack(frame, samples);
+        for(size_t n = 0; n < count; n++)
+        {
+            ITCHy::State* next = frames->claim();
+            ITCHy::State& sample = next ? *next : overflow;
+            sample = samples[n];
+            publishBackground(sample, next != nullptr, receiveTime);
+            received(sample);
+        }
+
+        return num;
+    }
+
+    int receiveBackground(int timeout)
+    {
+        return receiveBackground(timeout, [](const ITCHy::State&){});
+    }
+
+    void publishBackground(ITCHy::State& frame, bool inRing, uint64_t received)
+    {
+        stamp(frame, received);
+        if(inRing)
+        {
+            frames->publish();
+        }
+
+        Latest& next = latestFrame.writeBuffer();
+        next.state = frame;
+        next.motion = motion;
+        latestFrame.publish();
+        frameCount.fetch_add(1, std::memory_order_release);
+
+        frameReceived(frame);
+    }
+
+    // Consumer side: fetches the latest frame received in the background
+    void update()
+    {
+        if(latestFrame.update())
+        {
+            latest = &latestFrame.read();
+        }
+    }
+
+    // Hands the frame seen by the consumer over to background reception
+    void startBackground()
+    {
+        latestFrame.write(*latest);
+    }
+
+    // Takes the latest background frame back for synchronous reception
+    void stopBackground()
+    {
+        update();
+        if(latest != &synchronous[current])
+        {
+            synchronous[current] = *latest;
+            latest = &synchronous[current];
+        }
+    }
+
+    void stopReader()
+    {
+        readerRunning = false;
+        receiving = false;
+
+        // The reader thread itself may end up here via disconnect()
+        if(reader.joinable() && reader.get_id() != std::this_thread::get_id())
+        {
+            reader.join();
+        }
+    }
+};
+
+#endif // ITCHYIMPLEMENTATION_H
@@ -19,11 +19,36 @@ DEFINES += LIBITCHY_LIBRARY
 
 SOURCES += \
     itchy.cpp \
+    clockestimator.cpp \
+    commandwriter.cpp \
+    devicemanager.cpp \
+    hidrawtransport.cpp \
+    hotplugmonitor.cpp \
+    libusbtransport.cpp \
+    linkstatistics.cpp \
+    loopbacktransport.cpp \
+    motionpredictor.cpp \
+    replaytransport.cpp \
+    sessionrecorder.cpp \
+    simulation.cpp \
     pjrc_rawhid.c
 
 HEADERS += \
     itchy/itchy.h \
-    pjrc_rawhid.h
+    itchy/devicemanager.h \
+    itchy/motionpredictor.h \
+    itchy/protocol.h \
+    itchy/sessionrecorder.h \
+    itchy/simulation.h \
+    itchy/transport.h \
+    clockestimator.h \
+    commandwriter.h \
+    hotplugmonitor.h \
+    itchyimplementation.h \
+    linkstatistics.h \
+    pjrc_rawhid.h \
+    spscring.h \
+    triplebuffer.h
 
 !noscratchy {
     SOURCES += tactilemousequery.cpp
@@ -33,10 +58,15 @@ HEADERS += \
 
 LIBS += -lusb
 
+# Lets the loops of Simulation vectorize: sqrt without errno, and -O2 only
+# vectorizes loops that need no remainder handling
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += -O3 -fno-math-errno
+
 unix {
     target.path = $${INSTALL_PATH_LIB}
     header_files.path = $${INSTALL_PATH_INCLUDE}
-    header_files.files = itchy/itchy.h itchy/itchy
+    header_files.files = itchy/itchy.h itchy/devicemanager.h itchy/motionpredictor.h itchy/protocol.h itchy/sessionrecorder.h itchy/simulation.h itchy/transport.h itchy/itchy
     !noscratchy {
         header_files.files += itchy/tactilemousequery.h
     }
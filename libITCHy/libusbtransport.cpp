@@ -0,0 +1,53 @@
+#include "itchy/transport.h"
+
+extern "C" {
+#include "pjrc_rawhid.h"
+}
+
+LibUSBTransport::LibUSBTransport()
+{
+}
+
+LibUSBTransport::~LibUSBTransport()
+{
+    close();
+}
+
+bool LibUSBTransport::open(const DeviceIdentifier& identifier)
+{
+    if(opened)
+    {
+        return true;
+    }
+
+    int ret = rawhid_open(1,
+                          identifier[0], identifier[1],
+                          identifier[2], identifier[3]);
+
+    opened = (ret > 0);
+    return opened;
+}
+
+void LibUSBTransport::close()
+{
+    if(opened)
+    {
+        rawhid_close(0);
+        opened = false;
+    }
+}
+
+bool LibUSBTransport::isOpen() const
+{
+    return opened;
+}
+
+int LibUSBTransport::receive(char* buffer, int length, int timeout)
+{
+    return rawhid_recv(0, buffer, length, timeout);
+}
+
+int LibUSBTransport::send(const char* buffer, int length, int timeout)
+{
+    return rawhid_send(0, const_cast<char*>(buffer), length, timeout);
+}
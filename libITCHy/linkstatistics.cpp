@@ -0,0 +1,136 @@
+#include "linkstatistics.h"
+
+#include <cmath>
+
+LinkStatistics::LinkStatistics()
+{
+    for(size_t n = 0; n < ITCHy::Statistics::HistogramBins; n++)
+    {
+        intervalHistogram[n] = 0;
+        latencyHistogram[n] = 0;
+    }
+}
+
+size_t LinkStatistics::bin(uint64_t nanoseconds)
+{
+    uint64_t microseconds = nanoseconds / 1000;
+    if(microseconds == 0)
+    {
+        return 0;
+    }
+
+    size_t index = 64 - __builtin_clzll(microseconds);
+    return index < ITCHy::Statistics::HistogramBins ? index : ITCHy::Statistics::HistogramBins - 1;
+}
+
+void LinkStatistics::addFrame(const ITCHy::State& state, uint64_t sampleTime)
+{
+    increment(framesReceived);
+
+    // Frames of a multi-sample report share the receive time
+    if(previousHostTime != 0 && state.hostTime > previousHostTime)
+    {
+        increment(intervalHistogram[bin(state.hostTime - previousHostTime)]);
+    }
+    previousHostTime = state.hostTime;
+
+    if(sampleTime != 0 && state.hostTime >= sampleTime)
+    {
+        increment(latencyHistogram[bin(state.hostTime - sampleTime)]);
+    }
+
+    // Reports are numbered by firmware supporting it, frames of the same
+    // multi-sample report share the number. Lost reports are assumed to
+    // have carried as many frames as the previous one.
+    if(state.version != 0)
+    {
+        if(sequenceValid && state.sequence != previousSequence)
+        {
+            uint8_t lost = uint8_t(state.sequence - previousSequence - 1);
+            add(reportsLost, lost);
+            add(framesLost, uint64_t(lost) * framesInReport);
+            framesInReport = 0;
+        }
+        previousSequence = state.sequence;
+        sequenceValid = true;
+        framesInReport++;
+        return;
+    }
+
+    // Otherwise frames arrive at a fixed rate, gaps of more than 1.5 nominal
+    // intervals in the device time are counted as lost frames. The nominal
+    // interval follows the regular intervals only.
+    if(state.deviceTime == 0)
+    {
+        return;
+    }
+
+    if(previousDeviceTime != 0)
+    {
+        double interval = double(int32_t(state.deviceTime - previousDeviceTime));
+        if(interval > 0.0)
+        {
+            if(nominalInterval == 0.0 || interval < 1.5 * nominalInterval)
+            {
+                nominalInterval = (nominalInterval == 0.0) ? interval :
+                                  0.99 * nominalInterval + 0.01 * interval;
+            }
+            else
+            {
+                // One frame per report without sequence numbers
+                uint64_t lost = uint64_t(std::lround(interval / nominalInterval)) - 1;
+                add(reportsLost, lost);
+                add(framesLost, lost);
+            }
+        }
+    }
+    previousDeviceTime = state.deviceTime;
+}
+
+void LinkStatistics::addReceiveError()
+{
+    receiveErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::addCorruptedFrame()
+{
+    increment(framesCorrupted);
+}
+
+void LinkStatistics::addSendFailure()
+{
+    sendFailures.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::addConnection()
+{
+    connections.fetch_add(1, std::memory_order_relaxed);
+
+    // Called while no frames are being received
+    previousHostTime = 0;
+    previousDeviceTime = 0;
+    sequenceValid = false;
+    framesInReport = 0;
+}
+
+ITCHy::Statistics LinkStatistics::snapshot() const
+{
+    ITCHy::Statistics statistics;
+    statistics.framesReceived = framesReceived.load(std::memory_order_relaxed);
+    statistics.framesLost = framesLost.load(std::memory_order_relaxed);
+    statistics.reportsLost = reportsLost.load(std::memory_order_relaxed);
+    statistics.receiveErrors = receiveErrors.load(std::memory_order_relaxed);
+    statistics.framesCorrupted = framesCorrupted.load(std::memory_order_relaxed);
+    statistics.sendFailures = sendFailures.load(std::memory_order_relaxed);
+
+    uint64_t connected = connections.load(std::memory_order_relaxed);
+    statistics.reconnects = connected > 0 ? connected - 1 : 0;
+
+    for(size_t n = 0; n < ITCHy::Statistics::HistogramBins; n++)
+    {
+        statistics.intervalHistogram[n] = intervalHistogram[n].load(std::memory_order_relaxed);
+        statistics.latencyHistogram[n] = latencyHistogram[n].load(std::memory_order_relaxed);
+    }
+
+    return statistics;
+}
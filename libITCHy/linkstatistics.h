@@ -0,0 +1,65 @@
+#ifndef LINKSTATISTICS_H
+#define LINKSTATISTICS_H
+
+#include "itchy/itchy.h"
+
+#include <atomic>
+
+// Lock-free counters behind ITCHy::statistics(). Frames are added by the
+// single thread receiving them, errors and connections from any thread.
+// Readers may take a snapshot at any time.
+class LinkStatistics
+{
+public:
+    LinkStatistics();
+
+    // Called for each frame, sampleTime being the device time mapped to the
+    // host clock or 0 if no clock estimate is available yet
+    void addFrame(const ITCHy::State& state, uint64_t sampleTime);
+
+    void addReceiveError();
+    void addCorruptedFrame();
+    void addSendFailure();
+    // Restarts gap detection, the device may have been restarted
+    void addConnection();
+
+    ITCHy::Statistics snapshot() const;
+
+private:
+    typedef std::atomic<uint64_t> Counter;
+
+    // Single writer: avoids the locked read-modify-write of fetch_add
+    static void increment(Counter& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+    }
+
+    static void add(Counter& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+
+    static size_t bin(uint64_t nanoseconds);
+
+    Counter framesReceived{0};
+    Counter framesLost{0};
+    Counter reportsLost{0};
+    Counter receiveErrors{0};
+    Counter framesCorrupted{0};
+    Counter sendFailures{0};
+    Counter connections{0};
+    Counter intervalHistogram[ITCHy::Statistics::HistogramBins];
+    Counter latencyHistogram[ITCHy::Statistics::HistogramBins];
+
+    // Receiving thread only
+    uint64_t previousHostTime = 0;
+    uint32_t previousDeviceTime = 0;
+    bool sequenceValid = false;
+    uint8_t previousSequence = 0;
+    uint64_t framesInReport = 0;    // Received so far with previousSequence
+    double nominalInterval = 0.0;   // [us]
+};
+
+#endif // LINKSTATISTICS_H
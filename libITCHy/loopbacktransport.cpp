@@ -0,0 +1,115 @@
+#include "itchy/transport.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+namespace
+{
+
+using Report = std::array<char, 64>;
+
+struct ReportQueue
+{
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<Report> reports;
+
+    void push(const char* buffer, int length)
+    {
+        Report report = {{0}};
+        memcpy(report.data(), buffer,
+               length < int(report.size()) ? length : report.size());
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            reports.push_back(report);
+        }
+        available.notify_one();
+    }
+
+    int pop(char* buffer, int length, int timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(!available.wait_for(lock, std::chrono::milliseconds(timeout),
+                               [&](){ return !reports.empty(); }))
+        {
+            return 0;
+        }
+
+        int num = length < int(Report().size()) ? length : Report().size();
+        memcpy(buffer, reports.front().data(), num);
+        reports.pop_front();
+        return num;
+    }
+};
+
+}
+
+struct LoopbackTransport::impl
+{
+    bool opened = false;
+    ReportQueue toHost;
+    ReportQueue toDevice;
+};
+
+LoopbackTransport::LoopbackTransport()
+{
+    implementation = new impl;
+}
+
+LoopbackTransport::~LoopbackTransport()
+{
+    delete implementation;
+}
+
+bool LoopbackTransport::open(const DeviceIdentifier& identifier)
+{
+    (void) identifier;
+    implementation->opened = true;
+    return true;
+}
+
+void LoopbackTransport::close()
+{
+    implementation->opened = false;
+}
+
+bool LoopbackTransport::isOpen() const
+{
+    return implementation->opened;
+}
+
+int LoopbackTransport::receive(char* buffer, int length, int timeout)
+{
+    if(!implementation->opened)
+    {
+        return -1;
+    }
+
+    return implementation->toHost.pop(buffer, length, timeout);
+}
+
+int LoopbackTransport::send(const char* buffer, int length, int timeout)
+{
+    (void) timeout;
+    if(!implementation->opened)
+    {
+        return -1;
+    }
+
+    implementation->toDevice.push(buffer, length);
+    return length < 64 ? length : 64;
+}
+
+void LoopbackTransport::pushReport(const char* buffer, int length)
+{
+    implementation->toHost.push(buffer, length);
+}
+
+int LoopbackTransport::popCommand(char* buffer, int length, int timeout)
+{
+    return implementation->toDevice.pop(buffer, length, timeout);
+}
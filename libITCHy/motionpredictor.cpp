@@ -0,0 +1,142 @@
+#include "itchy/motionpredictor.h"
+
+#include <cmath>
+
+namespace
+{
+
+// Smoothing time constants of the finite difference estimates [s]
+const float VelocitySmoothing = 0.004f;
+const float AccelerationSmoothing = 0.010f;
+
+// The device scales the orientation by 0.75, wrapping it within 1.5 pi
+const float AngleRange = 1.5f * float(M_PI);
+
+float smoothing(float dt, float timeConstant)
+{
+    return 1.0f - std::exp(-dt / timeConstant);
+}
+
+}
+
+MotionPredictor::MotionPredictor()
+{
+    reset();
+}
+
+void MotionPredictor::reset()
+{
+    last = ITCHy::State();
+    lastTime = 0;
+    frames = 0;
+    velocity = {{0.0f, 0.0f}};
+    acceleration = {{0.0f, 0.0f}};
+    angularVelocity = 0.0f;
+    angularAcceleration = 0.0f;
+}
+
+void MotionPredictor::addFrame(const ITCHy::State& state, uint64_t sampleTime)
+{
+    if(frames == 0)
+    {
+        last = state;
+        lastTime = sampleTime;
+        frames = 1;
+        return;
+    }
+
+    // Duplicate or reordered frame
+    if(sampleTime <= lastTime)
+    {
+        last = state;
+        return;
+    }
+
+    float dt = float(sampleTime - lastTime) * 1e-9f;
+
+    float dAngle = state.angle - last.angle;
+    if(dAngle > 0.5f * AngleRange)
+    {
+        dAngle -= AngleRange;
+    }
+    else if(dAngle < -0.5f * AngleRange)
+    {
+        dAngle += AngleRange;
+    }
+
+    vec2f newVelocity = {{
+        (state.position[0] - last.position[0]) / dt,
+        (state.position[1] - last.position[1]) / dt
+    }};
+    float newAngularVelocity = dAngle / dt;
+
+    if(frames == 1)
+    {
+        velocity = newVelocity;
+        angularVelocity = newAngularVelocity;
+    }
+    else
+    {
+        float alpha = smoothing(dt, VelocitySmoothing);
+        vec2f previousVelocity = velocity;
+        float previousAngularVelocity = angularVelocity;
+
+        velocity[0] += alpha * (newVelocity[0] - velocity[0]);
+        velocity[1] += alpha * (newVelocity[1] - velocity[1]);
+        angularVelocity += alpha * (newAngularVelocity - angularVelocity);
+
+        float beta = smoothing(dt, AccelerationSmoothing);
+        acceleration[0] += beta * ((velocity[0] - previousVelocity[0]) / dt - acceleration[0]);
+        acceleration[1] += beta * ((velocity[1] - previousVelocity[1]) / dt - acceleration[1]);
+        angularAcceleration += beta * ((angularVelocity - previousAngularVelocity) / dt - angularAcceleration);
+    }
+
+    last = state;
+    lastTime = sampleTime;
+    if(frames < 2)
+    {
+        frames++;
+    }
+}
+
+bool MotionPredictor::valid() const
+{
+    return frames >= 2;
+}
+
+const ITCHy::State& MotionPredictor::state() const
+{
+    return last;
+}
+
+uint64_t MotionPredictor::sampleTime() const
+{
+    return lastTime;
+}
+
+ITCHy::State MotionPredictor::predict(uint64_t time, ITCHy::PredictionModel model) const
+{
+    ITCHy::State predicted = last;
+    predicted.hostTime = time;
+
+    if(!valid())
+    {
+        return predicted;
+    }
+
+    float dt = float(int64_t(time - lastTime)) * 1e-9f;
+
+    predicted.position[0] += velocity[0] * dt;
+    predicted.position[1] += velocity[1] * dt;
+    predicted.angle += angularVelocity * dt;
+
+    if(model == ITCHy::PredictionModel::ConstantAcceleration)
+    {
+        float dt2 = 0.5f * dt * dt;
+        predicted.position[0] += acceleration[0] * dt2;
+        predicted.position[1] += acceleration[1] * dt2;
+        predicted.angle += angularAcceleration * dt2;
+    }
+
+    return predicted;
+}
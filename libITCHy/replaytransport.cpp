@@ -0,0 +1,153 @@
+#include "itchy/transport.h"
+#include "itchy/sessionrecorder.h"
+
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+namespace
+{
+
+uint64_t now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return uint64_t(time.tv_sec) * 1000000000ull + uint64_t(time.tv_nsec);
+}
+
+}
+
+struct ReplayTransport::impl
+{
+    std::string fileName;
+    double speed;
+    SessionReader reader;
+
+    uint64_t next = 0;
+    std::atomic<bool> finished{false};
+
+    // Recording time of the first frame replayed and the host time it has
+    // been replayed at
+    uint64_t recordingStart = 0;
+    uint64_t replayStart = 0;
+    bool started = false;
+
+    // Skips commands, returns false at the end of the recording
+    bool nextFrame()
+    {
+        while(next < reader.recordCount() &&
+              reader.record(next).type != SessionRecord::Frame)
+        {
+            next++;
+        }
+
+        finished = next >= reader.recordCount();
+        return !finished;
+    }
+};
+
+ReplayTransport::ReplayTransport(const std::string& fileName, double speed)
+{
+    implementation = new impl;
+    implementation->fileName = fileName;
+    implementation->speed = speed;
+}
+
+ReplayTransport::~ReplayTransport()
+{
+    delete implementation;
+}
+
+bool ReplayTransport::open(const DeviceIdentifier& identifier)
+{
+    (void) identifier;
+
+    if(isOpen())
+    {
+        return true;
+    }
+
+    if(!implementation->reader.open(implementation->fileName))
+    {
+        return false;
+    }
+
+    seek(0);
+    return true;
+}
+
+void ReplayTransport::close()
+{
+    implementation->reader.close();
+}
+
+bool ReplayTransport::isOpen() const
+{
+    return implementation->reader.isOpen();
+}
+
+void ReplayTransport::seek(uint64_t hostTime)
+{
+    implementation->next = implementation->reader.seek(hostTime);
+    implementation->started = false;
+    implementation->nextFrame();
+}
+
+bool ReplayTransport::finished() const
+{
+    return implementation->finished;
+}
+
+int ReplayTransport::receive(char* buffer, int length, int timeout)
+{
+    if(!isOpen())
+    {
+        return -1;
+    }
+
+    if(!implementation->nextFrame())
+    {
+        // End of the recording, behave like a device that stopped sending
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+        return 0;
+    }
+
+    const SessionRecord& record = implementation->reader.record(implementation->next);
+
+    if(!implementation->started)
+    {
+        implementation->started = true;
+        implementation->recordingStart = record.hostTime;
+        implementation->replayStart = now();
+    }
+
+    if(implementation->speed > 0.0)
+    {
+        uint64_t due = implementation->replayStart + uint64_t(
+                    (record.hostTime - implementation->recordingStart) / implementation->speed);
+        uint64_t current = now();
+        if(due > current)
+        {
+            uint64_t limit = uint64_t(timeout) * 1000000ull;
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - current < limit ?
+                                                                 due - current : limit));
+            if(now() < due)
+            {
+                return 0;
+            }
+        }
+    }
+
+    int num = length < int(ITCHyProtocol::ReportSize) ? length : int(ITCHyProtocol::ReportSize);
+    memcpy(buffer, record.payload, num);
+    implementation->next++;
+    return num;
+}
+
+int ReplayTransport::send(const char* buffer, int length, int timeout)
+{
+    (void) buffer;
+    (void) timeout;
+    return isOpen() ? length : -1;
+}
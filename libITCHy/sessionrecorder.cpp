@@ -0,0 +1,360 @@
+#include "itchy/sessionrecorder.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+
+namespace
+{
+
+const char Magic[8] = {'I', 'T', 'C', 'H', 'Y', 'R', 'E', 'C'};
+const uint32_t Version = 1;
+const size_t HeaderSize = 64;
+
+// The file grows by this number of records at once
+const size_t ChunkRecords = 16384;
+
+static_assert(sizeof(SessionHeader) <= HeaderSize, "SessionHeader");
+static_assert(sizeof(SessionRecord) == 80, "SessionRecord");
+
+uint64_t now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return uint64_t(time.tv_sec) * 1000000000ull + uint64_t(time.tv_nsec);
+}
+
+}
+
+struct SessionRecorder::impl
+{
+    std::mutex mutex;
+    int fd = -1;
+    char* map = nullptr;
+    size_t mapped = 0;
+    uint64_t count = 0;
+
+    // Host time of the last record [ns]
+    uint64_t lastTime = 0;
+
+    SessionHeader* header()
+    {
+        return reinterpret_cast<SessionHeader*>(map);
+    }
+
+    // Must be called with the mutex held
+    SessionRecord* append()
+    {
+        size_t end = HeaderSize + (count + 1) * sizeof(SessionRecord);
+        if(end > mapped)
+        {
+            size_t size = mapped + ChunkRecords * sizeof(SessionRecord);
+            if(ftruncate(fd, size) != 0)
+            {
+                return nullptr;
+            }
+
+            void* remapped = mremap(map, mapped, size, MREMAP_MAYMOVE);
+            if(remapped == MAP_FAILED)
+            {
+                return nullptr;
+            }
+
+            map = static_cast<char*>(remapped);
+            mapped = size;
+        }
+
+        return reinterpret_cast<SessionRecord*>(
+                    map + HeaderSize + count * sizeof(SessionRecord));
+    }
+
+    // Frames are stamped on receipt, before the mutex is taken. A frame
+    // recorded after a command stamped later gets the time of the command,
+    // keeping the host times sorted for SessionReader::seek(). Must be
+    // called with the mutex held.
+    uint64_t sorted(uint64_t time)
+    {
+        lastTime = std::max(lastTime, time);
+        return lastTime;
+    }
+
+    // Makes the record visible to readers mapping the same file
+    void commit()
+    {
+        count++;
+        __atomic_store_n(&header()->recordCount, count, __ATOMIC_RELEASE);
+    }
+};
+
+SessionRecorder::SessionRecorder()
+{
+    implementation = new impl;
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    close();
+    delete implementation;
+}
+
+bool SessionRecorder::open(const std::string& fileName)
+{
+    close();
+
+    std::lock_guard<std::mutex> lock(implementation->mutex);
+
+    int fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    size_t size = HeaderSize + ChunkRecords * sizeof(SessionRecord);
+    void* map = MAP_FAILED;
+    if(ftruncate(fd, size) == 0)
+    {
+        map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    if(map == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    implementation->fd = fd;
+    implementation->map = static_cast<char*>(map);
+    implementation->mapped = size;
+    implementation->count = 0;
+    implementation->lastTime = 0;
+
+    SessionHeader* header = implementation->header();
+    memcpy(header->magic, Magic, sizeof(Magic));
+    header->version = Version;
+    header->headerSize = HeaderSize;
+    header->recordSize = sizeof(SessionRecord);
+    header->reserved = 0;
+    header->startTime = now();
+    header->recordCount = 0;
+
+    return true;
+}
+
+void SessionRecorder::close()
+{
+    std::lock_guard<std::mutex> lock(implementation->mutex);
+    if(implementation->fd < 0)
+    {
+        return;
+    }
+
+    munmap(implementation->map, implementation->mapped);
+
+    // Cut off the unused part of the last chunk
+    int ret = ftruncate(implementation->fd,
+                        HeaderSize + implementation->count * sizeof(SessionRecord));
+    (void) ret;
+    ::close(implementation->fd);
+
+    implementation->fd = -1;
+    implementation->map = nullptr;
+    implementation->mapped = 0;
+}
+
+bool SessionRecorder::isOpen() const
+{
+    return implementation->fd >= 0;
+}
+
+void SessionRecorder::recordFrame(const ITCHy::State& state)
+{
+    std::lock_guard<std::mutex> lock(implementation->mutex);
+    if(implementation->fd < 0)
+    {
+        return;
+    }
+
+    SessionRecord* record = implementation->append();
+    if(!record)
+    {
+        return;
+    }
+
+    record->hostTime = implementation->sorted(state.hostTime);
+    record->type = SessionRecord::Frame;
+    record->reserved = 0;
+    memcpy(record->payload, &state, ITCHyProtocol::ReportSize);
+    implementation->commit();
+}
+
+void SessionRecorder::recordCommand(const char* buffer)
+{
+    std::lock_guard<std::mutex> lock(implementation->mutex);
+    if(implementation->fd < 0)
+    {
+        return;
+    }
+
+    SessionRecord* record = implementation->append();
+    if(!record)
+    {
+        return;
+    }
+
+    record->hostTime = implementation->sorted(now());
+    record->type = SessionRecord::Command;
+    record->reserved = 0;
+    memcpy(record->payload, buffer, ITCHyProtocol::ReportSize);
+    implementation->commit();
+}
+
+uint64_t SessionRecorder::recordCount() const
+{
+    std::lock_guard<std::mutex> lock(implementation->mutex);
+    return implementation->count;
+}
+
+
+struct SessionReader::impl
+{
+    int fd = -1;
+    const char* map = nullptr;
+    size_t size = 0;
+    uint64_t count = 0;
+    SessionHeader empty = SessionHeader();
+
+    const SessionHeader& header() const
+    {
+        return map ? *reinterpret_cast<const SessionHeader*>(map) : empty;
+    }
+};
+
+SessionReader::SessionReader()
+{
+    implementation = new impl;
+}
+
+SessionReader::~SessionReader()
+{
+    close();
+    delete implementation;
+}
+
+bool SessionReader::open(const std::string& fileName)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || size_t(info.st_size) < HeaderSize)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    const SessionHeader* header = static_cast<const SessionHeader*>(map);
+    if(memcmp(header->magic, Magic, sizeof(Magic)) != 0 ||
+       header->version != Version ||
+       header->recordSize != sizeof(SessionRecord) ||
+       header->headerSize < sizeof(SessionHeader))
+    {
+        munmap(map, info.st_size);
+        ::close(fd);
+        return false;
+    }
+
+    implementation->fd = fd;
+    implementation->map = static_cast<const char*>(map);
+    implementation->size = info.st_size;
+
+    // The file may still be written, only use committed records
+    uint64_t available = (info.st_size - header->headerSize) / sizeof(SessionRecord);
+    implementation->count = std::min<uint64_t>(
+                available, __atomic_load_n(&header->recordCount, __ATOMIC_ACQUIRE));
+
+    return true;
+}
+
+void SessionReader::close()
+{
+    if(implementation->fd < 0)
+    {
+        return;
+    }
+
+    munmap(const_cast<char*>(implementation->map), implementation->size);
+    ::close(implementation->fd);
+
+    implementation->fd = -1;
+    implementation->map = nullptr;
+    implementation->size = 0;
+    implementation->count = 0;
+}
+
+bool SessionReader::isOpen() const
+{
+    return implementation->fd >= 0;
+}
+
+const SessionHeader& SessionReader::header() const
+{
+    return implementation->header();
+}
+
+uint64_t SessionReader::recordCount() const
+{
+    return implementation->count;
+}
+
+const SessionRecord& SessionReader::record(uint64_t index) const
+{
+    return *reinterpret_cast<const SessionRecord*>(
+                implementation->map + implementation->header().headerSize +
+                index * sizeof(SessionRecord));
+}
+
+uint64_t SessionReader::seek(uint64_t hostTime) const
+{
+    uint64_t first = 0;
+    uint64_t last = implementation->count;
+    while(first < last)
+    {
+        uint64_t middle = first + (last - first) / 2;
+        if(record(middle).hostTime < hostTime)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+ITCHy::State SessionReader::frame(const SessionRecord& record)
+{
+    ITCHy::State state = ITCHy::State();
+    memcpy(&state, record.payload, ITCHyProtocol::ReportSize);
+    state.hostTime = record.hostTime;
+    return state;
+}
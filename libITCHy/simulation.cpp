@@ -0,0 +1,307 @@
+#include "itchy/simulation.h"
+#include "itchy/protocol.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Geometry of the device, see teensyHIDSimulator/src/simulationcore.h
+const float SensorDistance = 0.0756019f;
+const float Offset[4] = {-0.0124523f, 0.0356911f, 0.0124523f, -0.0356911f};
+const float StaticAngle = std::atan2(Offset[1], Offset[0]);
+
+// The device scales the orientation by 0.75
+const float AngleScale = 0.75f;
+
+// Acceleration of a spring-damper end point, per component
+inline float acceleration(float point, float velocity, float anchor,
+                          float stiffness, float damping, float inverseMass)
+{
+    return -(stiffness * (point - anchor) + damping * velocity) * inverseMass;
+}
+
+struct SymplecticEuler
+{
+    void operator()(float& p, float& v, float a, float k, float c, float m, float dt) const
+    {
+        v += acceleration(p, v, a, k, c, m) * dt;
+        p += v * dt;
+    }
+};
+
+struct VelocityVerlet
+{
+    void operator()(float& p, float& v, float a, float k, float c, float m, float dt) const
+    {
+        float half = v + acceleration(p, v, a, k, c, m) * 0.5f * dt;
+        p += half * dt;
+        v = half + acceleration(p, half, a, k, c, m) * 0.5f * dt;
+    }
+};
+
+struct RungeKutta4
+{
+    void operator()(float& p, float& v, float a, float k, float c, float m, float dt) const
+    {
+        float p1 = v;
+        float v1 = acceleration(p, v, a, k, c, m);
+        float p2 = v + 0.5f * dt * v1;
+        float v2 = acceleration(p + 0.5f * dt * p1, p2, a, k, c, m);
+        float p3 = v + 0.5f * dt * v2;
+        float v3 = acceleration(p + 0.5f * dt * p2, p3, a, k, c, m);
+        float p4 = v + dt * v3;
+        float v4 = acceleration(p + dt * p3, p4, a, k, c, m);
+
+        p += dt / 6.0f * (p1 + 2.0f * p2 + 2.0f * p3 + p4);
+        v += dt / 6.0f * (v1 + 2.0f * v2 + 2.0f * v3 + v4);
+    }
+};
+
+// Moves the anchors by the increments rotated into the frame of the
+// simulation and projects them onto a rigid body. The arrays never overlap,
+// which lets the compiler vectorize without checking.
+void project(float* __restrict leftX, float* __restrict leftY,
+             float* __restrict rightX, float* __restrict rightY,
+             const float* __restrict cosAngle, const float* __restrict sinAngle,
+             size_t count, vec2f left, vec2f right)
+{
+    for(size_t n = 0; n < count; n++)
+    {
+        float lx = leftX[n] + cosAngle[n] * left[0] - sinAngle[n] * left[1];
+        float ly = leftY[n] + sinAngle[n] * left[0] + cosAngle[n] * left[1];
+        float rx = rightX[n] + cosAngle[n] * right[0] - sinAngle[n] * right[1];
+        float ry = rightY[n] + sinAngle[n] * right[0] + cosAngle[n] * right[1];
+
+        float centerX = 0.5f * (lx + rx);
+        float centerY = 0.5f * (ly + ry);
+        float deltaX = lx - rx;
+        float deltaY = ly - ry;
+        float scale = 0.5f * SensorDistance / std::sqrt(deltaX * deltaX + deltaY * deltaY);
+
+        leftX[n] = centerX + deltaX * scale;
+        leftY[n] = centerY + deltaY * scale;
+        rightX[n] = centerX - deltaX * scale;
+        rightY[n] = centerY - deltaY * scale;
+    }
+}
+
+// The components are independent, so all variants are integrated in one
+// branch free loop per component
+template<typename Method>
+void integrate(float* __restrict point, float* __restrict velocity,
+               const float* __restrict anchor, const float* __restrict stiffness,
+               const float* __restrict damping, const float* __restrict inverseMass,
+               size_t count, float dt)
+{
+    Method method;
+    for(size_t n = 0; n < count; n++)
+    {
+        method(point[n], velocity[n], anchor[n], stiffness[n], damping[n], inverseMass[n], dt);
+    }
+}
+
+}
+
+Simulation::Simulation(Integrator integrator) :
+    method(integrator),
+    stepRate(0.0f),
+    time(0.0f),
+    timeStep(0.0f),
+    last()
+{
+}
+
+size_t Simulation::addVariant(const Parameters& parameters)
+{
+    settings.push_back(parameters);
+    for(int i = 0; i < 4; i++)
+    {
+        anchor[i].push_back(0.0f);
+        point[i].push_back(0.0f);
+        velocity[i].push_back(0.0f);
+    }
+    inverseMass.push_back(0.0f);
+    stiffness.push_back(0.0f);
+    damping.push_back(0.0f);
+    cosAngle.push_back(1.0f);
+    sinAngle.push_back(0.0f);
+    angle.push_back(0.0f);
+
+    size_t variant = settings.size() - 1;
+    setParameters(variant, parameters);
+    initialize(variant);
+    return variant;
+}
+
+size_t Simulation::variants() const
+{
+    return settings.size();
+}
+
+void Simulation::setParameters(size_t variant, const Parameters& parameters)
+{
+    settings[variant] = parameters;
+    inverseMass[variant] = 1.0f / parameters.mass;
+    stiffness[variant] = parameters.stiffness;
+    damping[variant] = parameters.damping;
+}
+
+const Simulation::Parameters& Simulation::parameters(size_t variant) const
+{
+    return settings[variant];
+}
+
+void Simulation::setIntegrator(Integrator integrator)
+{
+    method = integrator;
+}
+
+Simulation::Integrator Simulation::integrator() const
+{
+    return method;
+}
+
+void Simulation::setStepRate(float rate)
+{
+    stepRate = rate;
+}
+
+void Simulation::reset()
+{
+    for(size_t n = 0; n < settings.size(); n++)
+    {
+        initialize(n);
+    }
+    time = 0.0f;
+    timeStep = 0.0f;
+}
+
+bool Simulation::update(const ITCHy::State& report)
+{
+    if(ITCHyProtocol::format(reinterpret_cast<const char*>(&report)) != ITCHyProtocol::RawIncrements)
+    {
+        return false;
+    }
+
+    last = report;
+    if(report.button & ITCHyProtocol::RawReset)
+    {
+        reset();
+    }
+
+    unsigned int steps = 1;
+    if(stepRate > 0.0f)
+    {
+        steps = std::max(1u, unsigned(std::ceil(report.timeStep * stepRate)));
+    }
+
+    float fraction = 1.0f / float(steps);
+    vec2f left = {{report.leftSensor[0] * fraction, report.leftSensor[1] * fraction}};
+    vec2f right = {{report.rightSensor[0] * fraction, report.rightSensor[1] * fraction}};
+    for(unsigned int n = 0; n < steps; n++)
+    {
+        step(left, right, report.timeStep * fraction);
+    }
+
+    if(report.button & ITCHyProtocol::RawLifted)
+    {
+        lift();
+    }
+
+    return true;
+}
+
+void Simulation::step(const vec2f& left, const vec2f& right, float dt)
+{
+    size_t count = settings.size();
+
+    project(anchor[0].data(), anchor[1].data(), anchor[2].data(), anchor[3].data(),
+            cosAngle.data(), sinAngle.data(), count, left, right);
+
+    for(int i = 0; i < 4; i++)
+    {
+        switch(method)
+        {
+        case Integrator::SymplecticEuler:
+            integrate<SymplecticEuler>(point[i].data(), velocity[i].data(), anchor[i].data(),
+                                       stiffness.data(), damping.data(), inverseMass.data(), count, dt);
+            break;
+
+        case Integrator::VelocityVerlet:
+            integrate<VelocityVerlet>(point[i].data(), velocity[i].data(), anchor[i].data(),
+                                      stiffness.data(), damping.data(), inverseMass.data(), count, dt);
+            break;
+
+        case Integrator::RungeKutta4:
+            integrate<RungeKutta4>(point[i].data(), velocity[i].data(), anchor[i].data(),
+                                   stiffness.data(), damping.data(), inverseMass.data(), count, dt);
+            break;
+        }
+    }
+
+    for(size_t n = 0; n < count; n++)
+    {
+        angle[n] = AngleScale * (std::atan2(point[1][n] - point[3][n],
+                                            point[0][n] - point[2][n]) - StaticAngle);
+        cosAngle[n] = std::cos(angle[n]);
+        sinAngle[n] = std::sin(angle[n]);
+    }
+
+    time += dt;
+    timeStep = dt;
+}
+
+ITCHy::State Simulation::state(size_t variant) const
+{
+    ITCHy::State state = ITCHy::State();
+    state.position[0] = 0.5f * (point[0][variant] + point[2][variant]);
+    state.position[1] = 0.5f * (point[1][variant] + point[3][variant]);
+    state.angle = angle[variant];
+
+    // Same conventions as the firmware: the sum of both sensor velocities
+    state.velocity[0] = velocity[0][variant] + velocity[2][variant];
+    state.velocity[1] = velocity[1][variant] + velocity[3][variant];
+    state.angularVelocity = 0.5f * SensorDistance * (velocity[2][variant] - velocity[0][variant]);
+    state.button = last.button & ITCHyProtocol::RawButton;
+
+    state.leftSensor = {{point[0][variant], point[1][variant]}};
+    state.rightSensor = {{point[2][variant], point[3][variant]}};
+    state.timeStep = timeStep;
+    state.time = time;
+    state.deviceTime = last.deviceTime;
+
+    ITCHyProtocol::seal(reinterpret_cast<char*>(&state), last.sequence);
+    state.hostTime = last.hostTime;
+    return state;
+}
+
+void Simulation::initialize(size_t variant)
+{
+    for(int i = 0; i < 4; i++)
+    {
+        anchor[i][variant] = Offset[i];
+        point[i][variant] = Offset[i];
+        velocity[i][variant] = 0.0f;
+    }
+    cosAngle[variant] = 1.0f;
+    sinAngle[variant] = 0.0f;
+    angle[variant] = 0.0f;
+}
+
+void Simulation::lift()
+{
+    // Like the firmware: the sensors are placed at their offsets around the
+    // current position
+    for(size_t n = 0; n < settings.size(); n++)
+    {
+        float x = 0.5f * (point[0][n] + point[2][n]);
+        float y = 0.5f * (point[1][n] + point[3][n]);
+        for(int i = 0; i < 4; i++)
+        {
+            point[i][n] = Offset[i] + ((i % 2) ? y : x);
+            anchor[i][n] = point[i][n];
+        }
+    }
+}
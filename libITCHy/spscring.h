@@ -0,0 +1,158 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Lock-free single-producer/single-consumer ring buffer.
+// Producer and consumer indices as well as the individual slots are kept
+// on separate cache lines. If the ring is full, new items are rejected.
+template<typename T>
+class SPSCRing
+{
+public:
+    explicit SPSCRing(size_t minCapacity)
+    {
+        capacity = 2;
+        while(capacity < minCapacity)
+        {
+            capacity *= 2;
+        }
+        mask = capacity - 1;
+
+        void* memory = nullptr;
+        if(posix_memalign(&memory, CacheLine, capacity * sizeof(Slot)) != 0)
+        {
+            throw std::bad_alloc();
+        }
+
+        slots = static_cast<Slot*>(memory);
+        for(size_t n = 0; n < capacity; n++)
+        {
+            new (&slots[n]) Slot();
+        }
+    }
+
+    ~SPSCRing()
+    {
+        for(size_t n = 0; n < capacity; n++)
+        {
+            slots[n].~Slot();
+        }
+        free(slots);
+    }
+
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    // Producer: returns the next free slot or nullptr if the ring is full.
+    // The slot becomes visible to the consumer after calling publish().
+    T* claim()
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h - cachedTail >= capacity)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if(h - cachedTail >= capacity)
+            {
+                return nullptr;
+            }
+        }
+
+        return &slots[h & mask].value;
+    }
+
+    void publish()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+    bool push(const T& item)
+    {
+        T* slot = claim();
+        if(!slot)
+        {
+            return false;
+        }
+
+        *slot = item;
+        publish();
+        return true;
+    }
+
+    // Consumer: appends all available items to the given vector
+    size_t drain(std::vector<T>& items)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+
+        items.reserve(items.size() + (h - t));
+        for(size_t n = t; n != h; n++)
+        {
+            items.push_back(slots[n & mask].value);
+        }
+
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+
+    // Consumer: passes the available items in place to
+    // f(const T* first, size_t count, size_t stride) in up to two runs,
+    // stride being the distance between consecutive items in bytes
+    template<typename F>
+    size_t consume(F f)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t count = h - t;
+
+        if(count > 0)
+        {
+            size_t first = t & mask;
+            size_t run = std::min(count, capacity - first);
+            f(&slots[first].value, run, sizeof(Slot));
+            if(run < count)
+            {
+                f(&slots[0].value, count - run, sizeof(Slot));
+            }
+        }
+
+        tail.store(h, std::memory_order_release);
+        return count;
+    }
+
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) -
+               tail.load(std::memory_order_acquire);
+    }
+
+private:
+    static const size_t CacheLine = 64;
+
+    struct Slot
+    {
+        T value;
+        char padding[CacheLine - sizeof(T) % CacheLine];
+    };
+
+    Slot* slots = nullptr;
+    size_t capacity;
+    size_t mask;
+
+    // Producer side
+    std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    char producerPadding[CacheLine];
+
+    // Consumer side
+    std::atomic<size_t> tail{0};
+    char consumerPadding[CacheLine];
+};
+
+#endif // SPSCRING_H
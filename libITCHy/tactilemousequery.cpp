@@ -1,26 +1,96 @@
 #include "itchy/tactilemousequery.h"
 #include "itchy/itchy.h"
+#include "itchy/motionpredictor.h"
+#include "triplebuffer.h"
 
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <ctime>
 #include <iostream>
 #include <thread>
-#include <mutex>
+
+namespace
+{
+
+void futexWake(std::atomic<uint32_t>* address)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(address),
+            FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+// Blocks until *address differs from expected or the (absolute,
+// CLOCK_MONOTONIC based) deadline has passed
+void futexWait(std::atomic<uint32_t>* address, uint32_t expected,
+               const timespec& deadline)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(address),
+            FUTEX_WAIT_BITSET_PRIVATE, expected, &deadline, nullptr,
+            FUTEX_BITSET_MATCH_ANY);
+}
+
+}
 
 struct TactileMouseQuery::impl
 {
+    explicit impl(ITCHy::Transport* transport) :
+        mouse({0x16C0, 0x0486, 0xFFAB, 0x0200}, transport)
+    {
+    }
+
+    struct Frame
+    {
+        ITCHy::State state;
+        MotionPredictor motion;
+        uint32_t sequence = 0;
+    };
+
     bool detached = false;
-    bool detachedRunning = false;
+    std::atomic<bool> detachedRunning{false};
     std::thread* mouseThread = nullptr;
-    std::mutex mutex;
     unsigned int timeout;
     ITCHy mouse;
-    ITCHy::State stateA;
-    ITCHy::State stateB;
+
+    // Detached mode: frames are passed from the mouse thread using a
+    // wait-free triple buffer, the sequence number allows waiting for them
+    TripleBuffer<Frame> frames;
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<int> waiters{0};
+    uint32_t consumed = 0;
+
+    // Created on first use of descriptor() only
+    std::atomic<int> notifier{-1};
+
+    ITCHy::State state;
+    MotionPredictor motion;
+
+    ITCHy::State predict(float dt, ITCHy::PredictionModel model)
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t time = uint64_t(now.tv_sec) * 1000000000ull + uint64_t(now.tv_nsec) +
+                        int64_t(dt * 1e9f);
+
+        if(detached)
+        {
+            return motion.predict(time, model);
+        }
+
+        return mouse.predictState(time, model);
+    }
 };
 
-TactileMouseQuery::TactileMouseQuery(bool detached, unsigned int timeout)
+TactileMouseQuery::TactileMouseQuery(bool detached, unsigned int timeout) :
+    TactileMouseQuery(nullptr, detached, timeout)
+{
+}
+
+TactileMouseQuery::TactileMouseQuery(ITCHy::Transport* transport, bool detached, unsigned int timeout)
 {
-    implementation = new impl;
+    implementation = new impl(transport);
     implementation->timeout = timeout;
     implementation->detached = detached;
 }
@@ -28,24 +98,27 @@ TactileMouseQuery::TactileMouseQuery(bool detached, unsigned int timeout)
 TactileMouseQuery::~TactileMouseQuery()
 {
     implementation->detachedRunning = false;
-    usleep(2.5e5);
     if(implementation->mouseThread)
+    {
+        implementation->mouseThread->join();
         delete implementation->mouseThread;
+    }
     implementation->mouse.setColor({0,0,0});
     implementation->mouse.disconnect();
+    if(implementation->notifier >= 0)
+    {
+        close(implementation->notifier);
+    }
     delete implementation;
 }
 
 bool TactileMouseQuery::initialize()
 {
-    int cnt = 0;
-    while(!implementation->mouse.tryConnect() &&  cnt++ < 100)
+    // Wait up to one second for the device, reconnect automatically later on
+    if(implementation->mouse.connect(1000))
     {
-        usleep(10000);
-    }
+        implementation->mouse.setAutoConnect(true);
 
-    if(implementation->mouse.connected())
-    {
         feedback(255,128,0);
         implementation->detachedRunning = true;
         if(implementation->detached)
@@ -53,12 +126,45 @@ bool TactileMouseQuery::initialize()
             implementation->mouseThread = new std::thread(
                         [&]()
             {
+                ITCHy& mouse = implementation->mouse;
+                MotionPredictor motion;
                 while(implementation->detachedRunning)
                 {
-                    ITCHy::State tmp = implementation->mouse.currentState(500);
+                    // Wait for the device to come back after a cable bump
+                    if(!mouse.connected())
                     {
-                        std::lock_guard<std::mutex> guard(implementation->mutex);
-                        implementation->stateA = tmp;
+                        mouse.connect(500);
+                        continue;
+                    }
+
+                    uint64_t received = mouse.frameCount();
+                    const ITCHy::State& state = mouse.currentState(500);
+                    if(mouse.frameCount() == received)
+                    {
+                        continue;
+                    }
+
+                    uint64_t sampleTime = state.deviceTime ? mouse.hostTime(state.deviceTime) : 0;
+                    motion.addFrame(state, sampleTime ? sampleTime : state.hostTime);
+
+                    impl::Frame& frame = implementation->frames.writeBuffer();
+                    frame.state = state;
+                    frame.motion = motion;
+                    frame.sequence = implementation->sequence.load() + 1;
+                    implementation->frames.publish();
+
+                    implementation->sequence.store(frame.sequence);
+                    if(implementation->waiters.load() > 0)
+                    {
+                        futexWake(&implementation->sequence);
+                    }
+
+                    int notifier = implementation->notifier.load();
+                    if(notifier >= 0)
+                    {
+                        uint64_t one = 1;
+                        ssize_t written = write(notifier, &one, sizeof(one));
+                        (void)written;
                     }
                 }
             });
@@ -70,47 +176,148 @@ bool TactileMouseQuery::initialize()
 
 void TactileMouseQuery::feedback(unsigned char r, unsigned char g, unsigned char b)
 {
-    implementation->mouse.setColor({r,g,b});
+    implementation->mouse.setColorAsync({r,g,b});
 }
 
 void TactileMouseQuery::update()
 {
     if(implementation->detached)
     {
-        std::lock_guard<std::mutex> guard(implementation->mutex);
-        implementation->stateB = implementation->stateA;
+        // Reset the descriptor before fetching, a frame published in
+        // between makes it readable again
+        int notifier = implementation->notifier.load();
+        if(notifier >= 0)
+        {
+            uint64_t count;
+            ssize_t received = read(notifier, &count, sizeof(count));
+            (void)received;
+        }
+
+        if(implementation->frames.update())
+        {
+            implementation->state = implementation->frames.read().state;
+            implementation->motion = implementation->frames.read().motion;
+            implementation->consumed = implementation->frames.read().sequence;
+        }
     }
     else
     {
-        implementation->stateB = implementation->mouse.currentState(implementation->timeout);
+        implementation->state = implementation->mouse.currentState(implementation->timeout);
     }
 }
 
+bool TactileMouseQuery::waitForUpdate(std::chrono::steady_clock::time_point deadline)
+{
+    // update() waits for the device itself in attached mode
+    if(!implementation->detached)
+    {
+        return true;
+    }
+
+    auto remaining = deadline - std::chrono::steady_clock::now();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+    auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds);
+
+    timespec absolute;
+    clock_gettime(CLOCK_MONOTONIC, &absolute);
+    absolute.tv_sec += seconds.count();
+    absolute.tv_nsec += nanoseconds.count();
+    if(absolute.tv_nsec >= 1000000000)
+    {
+        absolute.tv_sec += 1;
+        absolute.tv_nsec -= 1000000000;
+    }
+    else if(absolute.tv_nsec < 0)
+    {
+        absolute.tv_sec -= 1;
+        absolute.tv_nsec += 1000000000;
+    }
+
+    implementation->waiters.fetch_add(1);
+    uint32_t current;
+    while((current = implementation->sequence.load()) == implementation->consumed)
+    {
+        if(std::chrono::steady_clock::now() >= deadline)
+        {
+            break;
+        }
+
+        futexWait(&implementation->sequence, current, absolute);
+    }
+    implementation->waiters.fetch_sub(1);
+
+    return current != implementation->consumed;
+}
+
+int TactileMouseQuery::descriptor()
+{
+    if(!implementation->detached)
+    {
+        return -1;
+    }
+
+    if(implementation->notifier < 0)
+    {
+        int notifier = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        int expected = -1;
+        if(!implementation->notifier.compare_exchange_strong(expected, notifier))
+        {
+            close(notifier);
+        }
+
+        // Frames that arrived before are pending as well
+        if(implementation->sequence.load() != implementation->consumed)
+        {
+            uint64_t one = 1;
+            ssize_t written = write(implementation->notifier, &one, sizeof(one));
+            (void)written;
+        }
+    }
+
+    return implementation->notifier;
+}
+
+ITCHy::Statistics TactileMouseQuery::statistics() const
+{
+    return implementation->mouse.statistics();
+}
+
 QVector2D TactileMouseQuery::position() const
 {
     return QVector2D(
-                implementation->stateB.position[0],
-                implementation->stateB.position[1]);
+                implementation->state.position[0],
+                implementation->state.position[1]);
 }
 
 QVector2D TactileMouseQuery::velocity() const
 {
     return QVector2D(
-                implementation->stateB.velocity[0],
-                implementation->stateB.velocity[1]);
+                implementation->state.velocity[0],
+                implementation->state.velocity[1]);
 }
 
 float TactileMouseQuery::orientation() const
 {
-    return implementation->stateB.angle;
+    return implementation->state.angle;
 }
 
 float TactileMouseQuery::angularVelocity() const
 {
-    return implementation->stateB.angularVelocity;
+    return implementation->state.angularVelocity;
+}
+
+QVector2D TactileMouseQuery::predictedPosition(float dt, ITCHy::PredictionModel model) const
+{
+    ITCHy::State predicted = implementation->predict(dt, model);
+    return QVector2D(predicted.position[0], predicted.position[1]);
+}
+
+float TactileMouseQuery::predictedOrientation(float dt, ITCHy::PredictionModel model) const
+{
+    return implementation->predict(dt, model).angle;
 }
 
 bool TactileMouseQuery::buttonPressed() const
 {
-   return (implementation->stateB.button == 1);
+   return (implementation->state.button == 1);
 }
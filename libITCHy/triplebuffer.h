@@ -0,0 +1,64 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Wait-free triple buffer for passing the most recent value from a single
+// writer to a single reader. Neither side ever blocks the other.
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    explicit TripleBuffer(const T& initial)
+    {
+        buffers[0] = buffers[1] = buffers[2] = initial;
+    }
+
+    // Writer: fill the buffer returned by writeBuffer(), then publish()
+    T& writeBuffer()
+    {
+        return buffers[back];
+    }
+
+    void publish()
+    {
+        back = middle.exchange(back | Dirty, std::memory_order_acq_rel) & Index;
+    }
+
+    void write(const T& value)
+    {
+        buffers[back] = value;
+        publish();
+    }
+
+    // Reader: fetch the latest published value (if any), then use read()
+    bool update()
+    {
+        if(!(middle.load(std::memory_order_relaxed) & Dirty))
+        {
+            return false;
+        }
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & Index;
+        return true;
+    }
+
+    const T& read() const
+    {
+        return buffers[front];
+    }
+
+private:
+    static const uint8_t Index = 0x03;
+    static const uint8_t Dirty = 0x04;
+
+    T buffers[3];
+    uint8_t back = 0;
+    std::atomic<uint8_t> middle{1};
+    uint8_t front = 2;
+};
+
+#endif // TRIPLEBUFFER_H
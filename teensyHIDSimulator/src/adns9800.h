@@ -0,0 +1,175 @@
+#ifndef ADNS9800_H
+#define ADNS9800_H
+
+// Registers and bring-up of the ADNS-9800. Header-only and free of Arduino
+// dependencies, so the boot sequence can be timed on the host (see
+// ITCHyBenchmark).
+
+#include "spischeduler.h"
+
+// Registers
+#define REG_Product_ID                           0x00
+#define REG_Revision_ID                          0x01
+#define REG_Motion                               0x02
+#define REG_Delta_X_L                            0x03
+#define REG_Delta_X_H                            0x04
+#define REG_Delta_Y_L                            0x05
+#define REG_Delta_Y_H                            0x06
+#define REG_SQUAL                                0x07
+#define REG_Pixel_Sum                            0x08
+#define REG_Maximum_Pixel                        0x09
+#define REG_Minimum_Pixel                        0x0a
+#define REG_Shutter_Lower                        0x0b
+#define REG_Shutter_Upper                        0x0c
+#define REG_Frame_Period_Lower                   0x0d
+#define REG_Frame_Period_Upper                   0x0e
+#define REG_Configuration_I                      0x0f
+#define REG_Configuration_II                     0x10
+#define REG_Frame_Capture                        0x12
+#define REG_SROM_Enable                          0x13
+#define REG_Run_Downshift                        0x14
+#define REG_Rest1_Rate                           0x15
+#define REG_Rest1_Downshift                      0x16
+#define REG_Rest2_Rate                           0x17
+#define REG_Rest2_Downshift                      0x18
+#define REG_Rest3_Rate                           0x19
+#define REG_Frame_Period_Max_Bound_Lower         0x1a
+#define REG_Frame_Period_Max_Bound_Upper         0x1b
+#define REG_Frame_Period_Min_Bound_Lower         0x1c
+#define REG_Frame_Period_Min_Bound_Upper         0x1d
+#define REG_Shutter_Max_Bound_Lower              0x1e
+#define REG_Shutter_Max_Bound_Upper              0x1f
+#define REG_LASER_CTRL0                          0x20
+#define REG_Observation                          0x24
+#define REG_Data_Out_Lower                       0x25
+#define REG_Data_Out_Upper                       0x26
+#define REG_SROM_ID                              0x2a
+#define REG_Lift_Detection_Thr                   0x2e
+#define REG_Configuration_V                      0x2f
+#define REG_Configuration_IV                     0x39
+#define REG_Power_Up_Reset                       0x3a
+#define REG_Shutdown                             0x3b
+#define REG_Inverse_Product_ID                   0x3f
+#define REG_Motion_Burst                         0x50
+#define REG_SROM_Load_Burst                      0x62
+#define REG_Pixel_Burst                          0x64
+
+// Layout of a motion burst
+#define BURST_Motion                             0
+#define BURST_Observation                        1
+#define BURST_Delta_X_L                          2
+#define BURST_Delta_X_H                          3
+#define BURST_Delta_Y_L                          4
+#define BURST_Delta_Y_H                          5
+#define BURST_SQUAL                              6
+#define BURST_Pixel_Sum                          7
+#define BURST_Maximum_Pixel                      8
+#define BURST_Minimum_Pixel                      9
+#define BURST_Shutter_Upper                      10
+#define BURST_Shutter_Lower                      11
+#define BURST_Frame_Period_Upper                 12
+#define BURST_Frame_Period_Lower                 13
+#define BURST_Length                             14
+
+// Motion register bits
+#define MOTION_Occured                           0x80
+#define MOTION_Fault                             0x40
+#define MOTION_Laser_Valid                       0x20
+
+namespace ADNS9800
+{
+
+// [us]
+const uint32_t ResetTime = 50000;       // After Power_Up_Reset
+const uint32_t FrameTime = 10000;       // SROM_Enable, and after the download
+const uint32_t SromByteTime = 15;       // tLOAD
+
+// Brings up the chips, waits of one chip are spent on the others. Chips
+// that already report sromId (after a reset of the MCU only, the sensors
+// keep their power) are not reset and keep their SROM; the others are reset
+// and get srom(0) to srom(sromLength - 1), one after the other or with
+// broadcast all at once (see SpiScheduler::upload()). Returns the number of
+// uploads.
+template<typename Scheduler, typename Source>
+int boot(Scheduler& spi, const int* chips, int count,
+         Source srom, int sromLength, uint8_t sromId, bool broadcast)
+{
+    uint8_t ids[Scheduler::MaxChipCount];
+    for(int i = 0; i < count; i++)
+    {
+        spi.queueRead(chips[i], REG_SROM_ID, &ids[i]);
+    }
+    spi.run();
+
+    int upload[Scheduler::MaxChipCount];
+    int uploads = 0;
+    for(int i = 0; i < count; i++)
+    {
+        if(ids[i] != sromId)
+        {
+            upload[uploads++] = chips[i];
+        }
+    }
+
+    // Reset, read registers 0x02 to 0x06 (and discard the data), enable the
+    // SROM download
+    uint8_t discard;
+    for(int i = 0; i < uploads; i++)
+    {
+        spi.queueWrite(upload[i], REG_Power_Up_Reset, 0x5a);
+        spi.queueDelay(upload[i], ResetTime);
+        for(uint8_t reg = REG_Motion; reg <= REG_Delta_Y_H; reg++)
+        {
+            spi.queueRead(upload[i], reg, &discard);
+        }
+        spi.queueWrite(upload[i], REG_Configuration_IV, 0x02);
+        spi.queueWrite(upload[i], REG_SROM_Enable, 0x1d);
+        spi.queueDelay(upload[i], FrameTime);
+        spi.queueWrite(upload[i], REG_SROM_Enable, 0x18);
+    }
+    spi.run();
+
+    if(broadcast)
+    {
+        spi.upload(upload, uploads, REG_SROM_Load_Burst, srom, sromLength, SromByteTime);
+    }
+    else
+    {
+        for(int i = 0; i < uploads; i++)
+        {
+            spi.upload(&upload[i], 1, REG_SROM_Load_Burst, srom, sromLength, SromByteTime);
+        }
+    }
+
+    // Enable laser (bit 0 = 0b), in normal mode (bits 3,2,1 = 000b).
+    // Reading the actual value of the register is important because the real
+    // default value is different from what is said in the datasheet, and if
+    // you change the reserved bytes (like by writing 0x00...) it would not
+    // work.
+    uint8_t laser[Scheduler::MaxChipCount];
+    for(int i = 0; i < uploads; i++)
+    {
+        spi.delay(upload[i], FrameTime);
+    }
+    for(int i = 0; i < count; i++)
+    {
+        spi.queueRead(chips[i], REG_LASER_CTRL0, &laser[i]);
+    }
+    spi.run();
+
+    for(int i = 0; i < count; i++)
+    {
+        spi.queueWrite(chips[i], REG_LASER_CTRL0, laser[i] & 0xf0);
+        //spi.queueWrite(chips[i], REG_Configuration_I, 0x01); // 200 dpi
+        //spi.queueWrite(chips[i], REG_Configuration_I, 0x09); // 1800 dpi
+        //spi.queueWrite(chips[i], REG_Configuration_I, 0x29); // 8200 dpi
+        spi.queueWrite(chips[i], REG_Configuration_I, 0xA4); // 8200 dpi
+    }
+    spi.run();
+
+    return uploads;
+}
+
+}
+
+#endif // ADNS9800_H
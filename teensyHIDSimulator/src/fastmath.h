@@ -0,0 +1,95 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+// Polynomial replacements for the libm calls of the simulation step, which
+// are emulated in software on CPUs without FPU. The error bounds below include
+// float rounding; ITCHyBenchmark checks them against libm on the host.
+// Header-only and free of Arduino dependencies.
+
+namespace FastMath
+{
+
+const float Pi = 3.14159265f;
+const float HalfPi = 1.57079633f;
+
+// Inverse square root by Newton iterations from a guess. Each iteration
+// squares the relative error e of the guess (to 1.5 e^2), so two iterations
+// from within 1% reach float precision, a relative error below 1.4e-7.
+inline float inverseSqrt(float value, float guess, int iterations = 2)
+{
+    for(int i = 0; i < iterations; i++)
+    {
+        guess *= 1.5f - 0.5f * value * guess * guess;
+    }
+    return guess;
+}
+
+// Angle of (x, y) in [-pi, pi] (Abramowitz and Stegun 4.4.49 on the octant).
+// The polynomial is exact to 2e-8 rad, rounding of the result raises the
+// error to 3.2e-7 rad near +-pi.
+inline float atan2(float y, float x)
+{
+    float ax = x < 0.0f ? -x : x;
+    float ay = y < 0.0f ? -y : y;
+    if(ax == 0.0f && ay == 0.0f)
+    {
+        return 0.0f;
+    }
+
+    bool steep = ay > ax;
+    float t = steep ? ax / ay : ay / ax;
+    float t2 = t * t;
+    float angle = t * (0.9999993329f + t2 * (-0.3332985605f + t2 * (0.1994653599f +
+                  t2 * (-0.1390853351f + t2 * (0.0964200441f + t2 * (-0.0559098861f +
+                  t2 * (0.0218612288f + t2 * -0.0040540580f)))))));
+
+    if(steep)
+    {
+        angle = HalfPi - angle;
+    }
+    if(x < 0.0f)
+    {
+        angle = Pi - angle;
+    }
+    return y < 0.0f ? -angle : angle;
+}
+
+// Cosine and sine, reduced to [-pi/4, pi/4] by quadrant. The Taylor
+// polynomials are exact to 3e-8 there, with rounding the error stays below
+// 1.6e-7 for |angle| up to 1.6 pi.
+inline void sincos(float angle, float& cosine, float& sine)
+{
+    float turns = angle * (2.0f / Pi);
+    int quadrant = int(turns < 0.0f ? turns - 0.5f : turns + 0.5f);
+    float x = angle - float(quadrant) * HalfPi;
+    float x2 = x * x;
+
+    float s = x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f +
+              x2 * (-1.0f / 5040.0f + x2 * (1.0f / 362880.0f)))));
+    float c = 1.0f + x2 * (-0.5f + x2 * (1.0f / 24.0f + x2 * (-1.0f / 720.0f +
+              x2 * (1.0f / 40320.0f))));
+
+    switch(quadrant & 3)
+    {
+    case 0:
+        cosine = c;
+        sine = s;
+        break;
+    case 1:
+        cosine = -s;
+        sine = c;
+        break;
+    case 2:
+        cosine = -c;
+        sine = -s;
+        break;
+    default:
+        cosine = s;
+        sine = -c;
+        break;
+    }
+}
+
+}
+
+#endif // FASTMATH_H
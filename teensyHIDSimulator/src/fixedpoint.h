@@ -0,0 +1,185 @@
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+// Q-format fixed point numbers for CPUs without FPU. A Fixed<F> stores
+// value * 2^F in 32 bits; products are formed in 64 bits and rounded to the
+// requested format, which the Cortex-M4 does in a single SMULL.
+// Header-only and free of Arduino dependencies.
+
+#include <cstdint>
+
+template<int F>
+struct Fixed
+{
+    int32_t value;
+
+    static Fixed fromFloat(float v)
+    {
+        float scaled = v * float(int64_t(1) << F);
+        return {int32_t(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f)};
+    }
+
+    float toFloat() const
+    {
+        return float(value) * (1.0f / float(int64_t(1) << F));
+    }
+
+    Fixed operator+(Fixed other) const { return {value + other.value}; }
+    Fixed operator-(Fixed other) const { return {value - other.value}; }
+    Fixed operator-() const { return {-value}; }
+    Fixed& operator+=(Fixed other) { value += other.value; return *this; }
+    Fixed& operator-=(Fixed other) { value -= other.value; return *this; }
+};
+
+// Rounding right shift of a 64 bit intermediate
+inline int64_t shift(int64_t value, int bits)
+{
+    return bits > 0 ? (value + (int64_t(1) << (bits - 1))) >> bits : value << -bits;
+}
+
+// Product in format R
+template<int R, int A, int B>
+inline Fixed<R> mul(Fixed<A> a, Fixed<B> b)
+{
+    return {int32_t(shift(int64_t(a.value) * b.value, A + B - R))};
+}
+
+// Conversion to format R
+template<int R, int F>
+inline Fixed<R> convert(Fixed<F> a)
+{
+    return {int32_t(shift(a.value, F - R))};
+}
+
+inline uint32_t isqrt(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = uint64_t(1) << 62;
+    while(bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while(bit)
+    {
+        if(value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return uint32_t(root);
+}
+
+// CORDIC based trigonometry, angles in Q29 [rad], results in Q30.
+// The error is bounded by a few units in the last place of the format.
+namespace Cordic
+{
+
+const int Iterations = 30;
+
+// atan(2^-i) [Q29]
+const int32_t Table[Iterations] = {
+    421657428, 248918915, 131521918, 66762579, 33510843, 16771758, 8387925,
+    4194219, 2097141, 1048575, 524288, 262144, 131072, 65536, 32768, 16384,
+    8192, 4096, 2048, 1024, 512, 256, 128, 64, 32, 16, 8, 4, 2, 1
+};
+
+const int32_t Pi = 1686629713;          // [Q29]
+const int32_t HalfPi = 843314857;       // [Q29]
+const int32_t Gain = 652032874;         // 1 / prod(sqrt(1 + 2^-2i)) [Q30]
+
+// Angle of (x, y) in (-pi, pi], x and y of any common format with
+// |(x, y)| < 2^30
+inline Fixed<29> atan2(int32_t y, int32_t x)
+{
+    int32_t angle = 0;
+    if(x < 0)
+    {
+        // Rotate into the right half plane
+        int32_t t = x;
+        if(y >= 0)
+        {
+            x = y;
+            y = -t;
+            angle = HalfPi;
+        }
+        else
+        {
+            x = -y;
+            y = t;
+            angle = -HalfPi;
+        }
+    }
+
+    for(int i = 0; i < Iterations; i++)
+    {
+        int32_t dx = x >> i;
+        int32_t dy = y >> i;
+        if(y > 0)
+        {
+            x += dy;
+            y -= dx;
+            angle += Table[i];
+        }
+        else
+        {
+            x -= dy;
+            y += dx;
+            angle -= Table[i];
+        }
+    }
+
+    return {angle};
+}
+
+// Cosine and sine of any angle Q29 holds (+-4 rad). The simulation passes
+// angles in (-3.79, 0.93] rad.
+inline void sincos(Fixed<29> angle, Fixed<30>& cosine, Fixed<30>& sine)
+{
+    int32_t z = angle.value;
+    bool flip = false;
+    if(z > HalfPi)
+    {
+        z -= Pi;
+        flip = true;
+    }
+    else if(z < -HalfPi)
+    {
+        z += Pi;
+        flip = true;
+    }
+
+    int32_t x = Gain;
+    int32_t y = 0;
+    for(int i = 0; i < Iterations; i++)
+    {
+        int32_t dx = x >> i;
+        int32_t dy = y >> i;
+        if(z >= 0)
+        {
+            x -= dy;
+            y += dx;
+            z -= Table[i];
+        }
+        else
+        {
+            x += dy;
+            y -= dx;
+            z += Table[i];
+        }
+    }
+
+    cosine.value = flip ? -x : x;
+    sine.value = flip ? -y : y;
+}
+
+}
+
+#endif // FIXEDPOINT_H
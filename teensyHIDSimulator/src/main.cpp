@@ -9,6 +9,7 @@
 #include <SPI.h>
 #include <elapsedMillis.h>
 #include <EEPROM.h>
+#include <cstring>
 
 enum class State
 {
@@ -38,56 +39,105 @@ union
 static elapsedMillis usbTimeout;
 static elapsedMicros simTime;
 
-const float sensorDistance = 0.0756019f;
+static vec2f calibration;
 
-const vec2f sensorLeftOffset = {
-    {-0.0124523f, 0.0356911f}
-};
+const color defaultColor = {{255, 64, 0}};
 
-const vec2f sensorRightOffset = {
-    {0.0124523f, -0.0356911f}
-};
+// The physics run in fixed point if ITCHY_FIXED_POINT is defined (see
+// Makefile). sim then only holds the pose read for the reports, see publish().
+#ifdef ITCHY_FIXED_POINT
+static SimulationFixed::State fixedSim;
+static SimulationFixed::Parameters fixedParameters;
 
-const float staticAngle = atan2(sensorLeftOffset[1], sensorLeftOffset[0]);
+void resetSimulation(SimulationState& sim)
+{
+    SimulationCore::reset(sim);
+    SimulationFixed::reset(fixedSim);
+}
 
-static vec2f calibration;
+void resetRotation(SimulationState& sim)
+{
+    sim.rawFlags |= ITCHyProtocol::RawLifted;
+    SimulationFixed::resetRotation(fixedSim);
+}
 
-const color defaultColor = {{255, 64, 0}};
+void setParameters(SimulationState& sim, const SimulationParameters& parameters)
+{
+    sim.inverseMass = 1.0f/parameters.mass;
+    fixedParameters = SimulationFixed::parameters(parameters);
+}
 
+void simulate(SimulationState&, const SimulationParameters&,
+              const Increment& deltaLeft, const Increment& deltaRight)
+{
+    SimulationFixed::step(fixedSim, fixedParameters, deltaLeft, deltaRight);
+}
 
+void advance(SimulationState&, uint32_t microseconds)
+{
+    SimulationFixed::advance(fixedSim, microseconds);
+}
+
+void publish(SimulationState& sim)
+{
+    SimulationFixed::publish(fixedSim, sim);
+}
+
+vec2f toFloat(const Increment& increment)
+{
+    return SimulationFixed::toFloat(increment);
+}
+#else
 void resetSimulation(SimulationState& sim)
 {
-    sim.dt = 0.0;
-    sim.time = 0.0;
+    SimulationCore::reset(sim);
+}
 
-    // Set relative positions of sensors:
-    sim.positionLeft = sensorLeftOffset;
-    sim.positionRight = sensorRightOffset;
+void resetRotation(SimulationState& sim)
+{
+    SimulationCore::resetRotation(sim);
+}
 
-    sim.rawLeft = sim.positionLeft;
-    sim.rawRight = sim.positionRight;
+void setParameters(SimulationState& sim, const SimulationParameters& parameters)
+{
+    sim.inverseMass = 1.0f/parameters.mass;
+}
 
-    sim.velocityLeft = {{0.0, 0.0}};
-    sim.velocityRight = {{0.0, 0.0}};
+void simulate(SimulationState& sim, const SimulationParameters& parameters,
+              const Increment& deltaLeft, const Increment& deltaRight)
+{
+    SimulationCore::step(sim, parameters, deltaLeft, deltaRight);
+}
 
-    sim.position = {{0.0f, 0.0f}};
-    sim.velocity = {{0.0f, 0.0f}};
-    sim.angle = 0.0f;
-    sim.angularVelocity = 0.0f;
-    sim.rotation = {{1.0f, 0.0f, 0.0f, 1.0f}};
+void advance(SimulationState& sim, uint32_t microseconds)
+{
+    SimulationCore::advance(sim, microseconds);
 }
 
-void resetRotation(SimulationState& sim)
+void publish(SimulationState&)
 {
-    // Set relative positions of sensors:
-    sim.positionLeft[0] = sensorLeftOffset[0] + sim.position[0];
-    sim.positionLeft[1] = sensorLeftOffset[1] + sim.position[1];
+}
+
+vec2f toFloat(const Increment& increment)
+{
+    return increment;
+}
+#endif
 
-    sim.positionRight[0] = sensorRightOffset[0] + sim.position[0];
-    sim.positionRight[1] = sensorRightOffset[1] + sim.position[1];
 
-    sim.rawLeft = sim.positionLeft;
-    sim.rawRight = sim.positionRight;
+// Fixed point value of a multi-sample report, saturating
+int16_t quantize(float value, float scale)
+{
+    float scaled = value / scale;
+    if(scaled > 32767.0f)
+    {
+        return 32767;
+    }
+    if(scaled < -32767.0f)
+    {
+        return -32767;
+    }
+    return int16_t(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
 }
 
 extern "C" int main(void)
@@ -103,6 +153,19 @@ extern "C" int main(void)
     USBPackage::Data& data = usbRaw.data;
     usbTimeout = 0;
 
+    // Multi-sample reports: up to SubSamples evenly spaced simulation steps
+    // are kept in between two reports
+    struct Step
+    {
+        vec2f position;
+        float angle;
+        uint32_t time;
+    };
+    ITCHyProtocol::ReportFormat reportFormat = ITCHyProtocol::Snapshot;
+    std::array<Step, ITCHyProtocol::SubSamples> steps;
+    size_t stepCount = 0;
+    uint32_t lastStep = 0;
+
     SPI.begin();
     SPI.setDataMode(SPI_MODE3);
     SPI.setBitOrder(MSBFIRST);
@@ -111,10 +174,16 @@ extern "C" int main(void)
     Sensor rightSensor({{15, 16}}, true, false); // Cyan
     Sensor leftSensor({{9, 8}}, false, true);    // Green
 
+    Sensor::boot(rightSensor, leftSensor);
     leftSensor.reset();
     rightSensor.reset();
 
-    LED.blink(defaultColor, 1.0);
+#ifdef ITCHY_MOTION_INTERRUPTS
+    leftSensor.setInterruptDriven(true);
+    rightSensor.setInterruptDriven(true);
+#endif
+
+    LED.blink(defaultColor, 0.2);
     LED.on();
 
     // Thumb button state
@@ -138,7 +207,7 @@ extern "C" int main(void)
 
         calibration = eepData.data.calibration;
         parameters = eepData.data.parameters;
-        sim.inverseMass = 1.0f/parameters.mass;
+        setParameters(sim, parameters);
         leftSensor.setCalibration(eepData.data.calibStateLeft);
         rightSensor.setCalibration(eepData.data.calibStateRight);
     }
@@ -150,7 +219,7 @@ extern "C" int main(void)
         parameters.stiffness = 2000.0f;
         parameters.damping = 30.0f;
         parameters.updateRate = 20;
-        sim.inverseMass = 1.0f/parameters.mass;
+        setParameters(sim, parameters);
 
         Sensor::CalibrationState defaultCalibration;
         defaultCalibration.alpha[0] = 0.0;
@@ -230,7 +299,19 @@ extern "C" int main(void)
         resetSimulation(sim);
         leftSensor.reset();
         rightSensor.reset();
-        sim.inverseMass = 1.0f/parameters.mass;
+        setParameters(sim, parameters);
+    };
+
+    USB.onReportFormat() = [&](ITCHyProtocol::ReportFormat format)
+    {
+        // The host simulation starts from the initial pose
+        if(format == ITCHyProtocol::RawIncrements && reportFormat != format)
+        {
+            resetSimulation(sim);
+        }
+
+        reportFormat = format;
+        stepCount = 0;
     };
 
     USB.onSaveConfiguration() = [&]()
@@ -297,6 +378,7 @@ extern "C" int main(void)
         {
             LED.on();
             LED.setColor({{255,0,0}});
+            Sensor::poll(leftSensor, rightSensor);
             leftSensor.integrate();
             rightSensor.integrate();            
 
@@ -322,6 +404,7 @@ extern "C" int main(void)
 
         if(state == State::CalibrateY)
         {
+            Sensor::poll(leftSensor, rightSensor);
             leftSensor.integrate();
             rightSensor.integrate();
 
@@ -352,110 +435,26 @@ extern "C" int main(void)
             USB.checkIncoming();
 
             // Get movement since last frame in [m]
-            vec2f deltaLeftRaw = leftSensor.integrate();
-            vec2f deltaRightRaw = rightSensor.integrate();
-
-            vec2f deltaLeft = mul(sim.rotation, deltaLeftRaw);
-            vec2f deltaRight = mul(sim.rotation, deltaRightRaw);
-
-            sim.rawLeft = add(sim.rawLeft, deltaLeft);
-            sim.rawRight = add(sim.rawRight, deltaRight);
-
-            // Projection onto rigid body
-            vec2f rawCenter = mul(
-                        add(sim.rawLeft, sim.rawRight),
-                        0.5f);
-
-            vec2f rawDelta = {{
-                                  sim.rawLeft[0] - sim.rawRight[0],
-                                  sim.rawLeft[1] - sim.rawRight[1]
-                              }};
-
-            float rawLengthInv = invLen(rawDelta);
-
-            rawDelta = mul(rawDelta, rawLengthInv);
-
-
-            sim.rawLeft = add(rawCenter,
-                                   mul(rawDelta, sensorDistance*0.5f));
-
-            sim.rawRight = sub(rawCenter,
-                                   mul(rawDelta, sensorDistance*0.5f));
-
-            // Calculate forces
-            vec2f diffLeft  = mul(sub(sim.positionLeft, sim.rawLeft),
-                                  parameters.stiffness);
-            vec2f diffRight = mul(sub(sim.positionRight, sim.rawRight),
-                                  parameters.stiffness);
-
-            vec2f dampedVLeft = mul(sim.velocityLeft, parameters.damping);
-            vec2f dampedVRight = mul(sim.velocityRight, parameters.damping);
-
-            vec2f accelLeft = mul(add(diffLeft, dampedVLeft), sim.inverseMass);
-            vec2f accelRight = mul(add(diffRight, dampedVRight), sim.inverseMass);
-
-            // Velocity half-step
-            vec2f velHalfLeft = sub(sim.velocityLeft, mul(accelLeft, 0.5 * sim.dt));
-            vec2f velHalfRight = sub(sim.velocityRight, mul(accelRight, 0.5 * sim.dt));
-
-            // Integrate positions
-            sim.positionLeft = add(sim.positionLeft,
-                                   mul(velHalfLeft,
-                                       sim.dt));
+            Sensor::poll(leftSensor, rightSensor);
+            Increment deltaLeftRaw = leftSensor.integrate();
+            Increment deltaRightRaw = rightSensor.integrate();
+            uint32_t sampleTime = micros();
 
-            sim.positionRight = add(sim.positionRight,
-                                   mul(velHalfRight,
-                                       sim.dt));
-
-            // Calculate forces for t + dt
-            diffLeft  = mul(sub(sim.positionLeft, sim.rawLeft),
-                                  parameters.stiffness);
-            diffRight = mul(sub(sim.positionRight, sim.rawRight),
-                                  parameters.stiffness);
-
-            dampedVLeft = mul(velHalfLeft, parameters.damping);
-            dampedVRight = mul(velHalfRight, parameters.damping);
-
-            accelLeft = mul(add(diffLeft, dampedVLeft), sim.inverseMass);
-            accelRight = mul(add(diffRight, dampedVRight), sim.inverseMass);
-
-            // Integrate velocity
-            sim.velocityLeft  = sub(velHalfLeft, mul(accelLeft, 0.5 * sim.dt));
-            sim.velocityRight = sub(velHalfRight, mul(accelRight, 0.5 * sim.dt));
-
-
-            // Calculate current rotation            
-            vec2f posDelta = {{
-                                  sim.positionLeft[0] - sim.positionRight[0],
-                                  sim.positionLeft[1] - sim.positionRight[1]
-                              }};
-
-            float deltaLengthInv = invLen(posDelta);
-
-            posDelta = mul(posDelta, deltaLengthInv);
-
-            sim.position = mul(
-                        add(sim.positionLeft, sim.positionRight),
-                        0.5f);
-
-            sim.angle = 0.75f * (atan2(posDelta[1], posDelta[0]) - staticAngle);
-
-            float sinAlpha = sin(sim.angle);
-            float cosAlpha = cos(sim.angle);
-
-            sim.rotation = {{
-                               cosAlpha, -sinAlpha,
-                               sinAlpha,  cosAlpha
-                            }};
-
-            // Apply impulses (assume equal mass everywhere)
-            sim.velocity = add(sim.velocityLeft, sim.velocityRight);
-            sim.angularVelocity = cross({{0.0, sensorDistance*0.5f}}, sim.velocityLeft);
-            sim.angularVelocity += cross({{0.0, -sensorDistance*0.5f}}, sim.velocityRight);
+            // The host simulates raw increments itself
+            if(reportFormat == ITCHyProtocol::RawIncrements)
+            {
+                sim.incrementLeft = add(sim.incrementLeft, toFloat(deltaLeftRaw));
+                sim.incrementRight = add(sim.incrementRight, toFloat(deltaRightRaw));
+            }
+            else
+            {
+                simulate(sim, parameters, deltaLeftRaw, deltaRightRaw);
+            }
 
 
             if(usbTimeout > parameters.updateRate)
             {
+              publish(sim);
               data.position = sim.position;
               data.velocity = sim.velocity;
               data.angle = sim.angle;
@@ -482,11 +481,79 @@ extern "C" int main(void)
 
               data.time = sim.time;
               data.timeStep = sim.dt;
-
-              USB.sendFrame(usbRaw);
+              data.deviceTime = sampleTime;
+
+              // Sub-samples replace the sensor, debug and simulation data
+              if(reportFormat == ITCHyProtocol::MultiSample)
+              {
+                  for(size_t n = 0; n < ITCHyProtocol::SubSamples; n++)
+                  {
+                      ITCHyProtocol::SubSample sample = {{0, 0}, 0, 0};
+                      if(n < stepCount)
+                      {
+                          // The angle wraps within 1.5 pi
+                          float angle = steps[n].angle - sim.angle;
+                          if(angle > 0.75f * float(M_PI))
+                          {
+                              angle -= 1.5f * float(M_PI);
+                          }
+                          else if(angle < -0.75f * float(M_PI))
+                          {
+                              angle += 1.5f * float(M_PI);
+                          }
+
+                          uint32_t age = sampleTime - steps[n].time;
+                          sample.position[0] = quantize(steps[n].position[0] - sim.position[0],
+                                                        ITCHyProtocol::SubSamplePositionScale);
+                          sample.position[1] = quantize(steps[n].position[1] - sim.position[1],
+                                                        ITCHyProtocol::SubSamplePositionScale);
+                          sample.angle = quantize(angle, ITCHyProtocol::SubSampleAngleScale);
+                          sample.age = uint16_t(age < 65535 ? age : 65535);
+                      }
+
+                      memcpy(usbRaw.raw + ITCHyProtocol::Offset::SubSample + n * sizeof(sample),
+                             &sample, sizeof(sample));
+                  }
+                  stepCount = 0;
+              }
+              else if(reportFormat == ITCHyProtocol::RawIncrements)
+              {
+                  data.button = thumbButtonState | sim.rawFlags;
+                  data.leftSensor = sim.incrementLeft;
+                  data.rightSensor = sim.incrementRight;
+                  data.timeStep = float(sim.incrementTime) * 1.0e-6f;
+
+                  sim.incrementLeft = {{0.0f, 0.0f}};
+                  sim.incrementRight = {{0.0f, 0.0f}};
+                  sim.incrementTime = 0;
+                  sim.rawFlags = 0;
+              }
+
+              USB.sendFrame(usbRaw, reportFormat);
               usbTimeout = 0;
               thumbButtonState = 0;
             }
+            else if(reportFormat == ITCHyProtocol::MultiSample)
+            {
+                uint32_t spacing = (parameters.updateRate + 1) * 1000 /
+                                   (ITCHyProtocol::SubSamples + 1);
+                if(sampleTime - lastStep >= spacing)
+                {
+                    // Drop the oldest step if the report is late
+                    if(stepCount == steps.size())
+                    {
+                        for(size_t n = 1; n < steps.size(); n++)
+                        {
+                            steps[n - 1] = steps[n];
+                        }
+                        stepCount--;
+                    }
+
+                    publish(sim);
+                    steps[stepCount++] = {sim.position, sim.angle, sampleTime};
+                    lastStep = sampleTime;
+                }
+            }
 
             if(thumbButton.query() && resetButton.query())
             {
@@ -521,8 +588,10 @@ extern "C" int main(void)
                 resetRotation(sim);
             }
 
-            sim.dt = float(simTime) * 1.0e-6f;
+            uint32_t elapsed = simTime;
             simTime = 0;
+            advance(sim, elapsed);
+            sim.incrementTime += elapsed;
         }
     }
 }
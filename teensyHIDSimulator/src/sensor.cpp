@@ -1,4 +1,5 @@
 #include "sensor.h"
+#include "adns9800.h"
 
 #include <WProgram.h>
 #include <avr/pgmspace.h>
@@ -6,92 +7,79 @@
 #include "statusled.h"
 #include <SPI.h>
 
-// Registers
-#define REG_Product_ID                           0x00
-#define REG_Revision_ID                          0x01
-#define REG_Motion                               0x02
-#define REG_Delta_X_L                            0x03
-#define REG_Delta_X_H                            0x04
-#define REG_Delta_Y_L                            0x05
-#define REG_Delta_Y_H                            0x06
-#define REG_SQUAL                                0x07
-#define REG_Pixel_Sum                            0x08
-#define REG_Maximum_Pixel                        0x09
-#define REG_Minimum_Pixel                        0x0a
-#define REG_Shutter_Lower                        0x0b
-#define REG_Shutter_Upper                        0x0c
-#define REG_Frame_Period_Lower                   0x0d
-#define REG_Frame_Period_Upper                   0x0e
-#define REG_Configuration_I                      0x0f
-#define REG_Configuration_II                     0x10
-#define REG_Frame_Capture                        0x12
-#define REG_SROM_Enable                          0x13
-#define REG_Run_Downshift                        0x14
-#define REG_Rest1_Rate                           0x15
-#define REG_Rest1_Downshift                      0x16
-#define REG_Rest2_Rate                           0x17
-#define REG_Rest2_Downshift                      0x18
-#define REG_Rest3_Rate                           0x19
-#define REG_Frame_Period_Max_Bound_Lower         0x1a
-#define REG_Frame_Period_Max_Bound_Upper         0x1b
-#define REG_Frame_Period_Min_Bound_Lower         0x1c
-#define REG_Frame_Period_Min_Bound_Upper         0x1d
-#define REG_Shutter_Max_Bound_Lower              0x1e
-#define REG_Shutter_Max_Bound_Upper              0x1f
-#define REG_LASER_CTRL0                          0x20
-#define REG_Observation                          0x24
-#define REG_Data_Out_Lower                       0x25
-#define REG_Data_Out_Upper                       0x26
-#define REG_SROM_ID                              0x2a
-#define REG_Lift_Detection_Thr                   0x2e
-#define REG_Configuration_V                      0x2f
-#define REG_Configuration_IV                     0x39
-#define REG_Power_Up_Reset                       0x3a
-#define REG_Shutdown                             0x3b
-#define REG_Inverse_Product_ID                   0x3f
-#define REG_Motion_Burst                         0x50
-#define REG_SROM_Load_Burst                      0x62
-#define REG_Pixel_Burst                          0x64
+// Reads in interrupt driven mode also refresh SQUAL, which changes without
+// motion when the mouse is lifted [us]
+#define MOTION_Refresh_Interval                  8000
+
+Sensor* Sensor::interruptSensors[2] = {nullptr, nullptr};
+
+uint32_t TeensySpi::micros()
+{
+    return ::micros();
+}
+
+void TeensySpi::wait(uint32_t microseconds)
+{
+    delayMicroseconds(microseconds);
+}
+
+void TeensySpi::select(uint8_t pin, bool selected)
+{
+    digitalWrite(pin, selected ? LOW : HIGH);
+}
+
+uint8_t TeensySpi::transfer(uint8_t value)
+{
+    return SPI.transfer(value);
+}
+
+SpiScheduler<TeensySpi>& Sensor::spi()
+{
+    static TeensySpi bus;
+    static SpiScheduler<TeensySpi> scheduler(bus);
+    return scheduler;
+}
 
 Sensor::Sensor(std::array<unsigned char, 2> pins, bool flipX, bool flipY)
 {
     this->lifted = false;
+    this->squal = 0;
+    this->shutter = 0;
+    this->interruptSlot = -1;
+    this->pendingDelta[0] = 0;
+    this->pendingDelta[1] = 0;
+    this->pendingStatus = 0;
+    this->lastRead = 0;
+    this->polled = false;
     this->flipX = flipX;
     this->flipY = flipY;
     integrated = {{0,0}};
     this->pins = pins;
     pinMode (pins[0], OUTPUT); // Chip select
-    pinMode (pins[1], INPUT_PULLUP); // Motion pin
-    //attachInterrupt(mot, sensorChanged, FALLING);
+    chip = spi().addChip(pins[0]);
+    pinMode (pins[1], INPUT_PULLUP); // Motion pin, see setInterruptDriven()
 
-    // TODO: which parts of the code have to be executed once / foreach sensor ?
     adns_com_end(); // ensure that the serial port is reset
     adns_com_begin(); // ensure that the serial port is reset
     adns_com_end(); // ensure that the serial port is reset
-    adns_write_reg(REG_Power_Up_Reset, 0x5a); // force reset
-    delay(50); // wait for it to reboot
-    // read registers 0x02 to 0x06 (and discard the data)
-    adns_read_reg(REG_Motion);
-    adns_read_reg(REG_Delta_X_L);
-    adns_read_reg(REG_Delta_X_H);
-    adns_read_reg(REG_Delta_Y_L);
-    adns_read_reg(REG_Delta_Y_H);
-    // upload the firmware
-    uploadFirmware();
-
-    delay(10);
-    //enable laser(bit 0 = 0b), in normal mode (bits 3,2,1 = 000b)
-    // reading the actual value of the register is important because the real
-    // default value is different from what is said in the datasheet, and if you
-    // change the reserved bytes (like by writing 0x00...) it would not work.
-    byte laser_ctrl0 = adns_read_reg(REG_LASER_CTRL0);
-    adns_write_reg(REG_LASER_CTRL0, laser_ctrl0 & 0xf0 );
-    //adns_write_reg(REG_Configuration_I, 0x01 ); // 200 dpi
-    //adns_write_reg(REG_Configuration_I, 0x09 ); // 1800 dpi
-    //adns_write_reg(REG_Configuration_I, 0x29 ); // 8200 dpi
-    adns_write_reg(REG_Configuration_I, 0xA4 ); // 8200 dpi
-
-    delay(1);
+}
+
+void Sensor::boot(Sensor& first, Sensor& second)
+{
+    int chips[2] = {first.chip, second.chip};
+
+    // The ID of the SROM is its second byte
+    auto srom = [](int index)
+    {
+        return (unsigned char)pgm_read_byte(firmware_data + index);
+    };
+
+#ifdef ITCHY_PARALLEL_SROM_UPLOAD
+    bool broadcast = true;
+#else
+    bool broadcast = false;
+#endif
+    ADNS9800::boot(spi(), chips, 2, srom, firmware_length, srom(1), broadcast);
 }
 
 void Sensor::setCalibrationTarget(vec2f target)
@@ -101,77 +89,159 @@ void Sensor::setCalibrationTarget(vec2f target)
 
 void Sensor::adns_com_begin()
 {
-    digitalWrite(pins[0], LOW);
+    spi().begin(chip);
 }
 
 void Sensor::adns_com_end()
 {
-    digitalWrite(pins[0], HIGH);
+    spi().end(chip, 0);
 }
 
+// The gaps after each access are left to the scheduler, see spischeduler.h
 byte Sensor::adns_read_reg(byte reg_addr)
 {
-    adns_com_begin();    
-    SPI.transfer(reg_addr & 0x7f );
-    delayMicroseconds(100);
-    byte data = SPI.transfer(0);
-    delayMicroseconds(1);
-    adns_com_end();
-    delayMicroseconds(19);
-    return data;
+    return spi().read(chip, reg_addr);
+}
+
+// Reads the motion registers in one transaction: the address is followed by
+// tSRAD_MOTBR (35 us) instead of tSRAD (100 us) once per register, and no
+// tSRR/tSRW gap is needed between them. Reading the deltas clears them just
+// like the register reads.
+void Sensor::adns_read_burst(byte* data, int length)
+{
+    spi().burst(chip, REG_Motion_Burst, data, length);
 }
 
 void Sensor::adns_write_reg(byte reg_addr, byte data)
 {
-    adns_com_begin();    
-    SPI.transfer(reg_addr | 0x80 );
-    SPI.transfer(data);
-    delayMicroseconds(20);
-    adns_com_end();
-    delayMicroseconds(100);
+    spi().write(chip, reg_addr, data);
 }
 
-void Sensor::uploadFirmware()
-{    
-    adns_write_reg(REG_Configuration_IV, 0x02);
-    adns_write_reg(REG_SROM_Enable, 0x1d);
-    delay(10);
-    adns_write_reg(REG_SROM_Enable, 0x18);
-    adns_com_begin();
-    SPI.transfer(REG_SROM_Load_Burst | 0x80);
-    delayMicroseconds(15);
-    unsigned char c;
-    for (int i = 0; i < firmware_length; i++) {
-      c = (unsigned char)pgm_read_byte(firmware_data + i);
-      SPI.transfer(c);
-      delayMicroseconds(15);
+void Sensor::setInterruptDriven(bool enabled)
+{
+    if(enabled == (interruptSlot >= 0))
+    {
+        return;
     }
-    adns_com_end();
+
+    if(enabled)
+    {
+        int slot = interruptSensors[0] ? 1 : 0;
+        if(interruptSensors[slot])
+        {
+            return;
+        }
+        interruptSensors[slot] = this;
+        interruptSlot = slot;
+        attachInterrupt(pins[1], slot ? motionInterrupt1 : motionInterrupt0, FALLING);
+    }
+    else
+    {
+        detachInterrupt(pins[1]);
+        interruptSensors[interruptSlot] = nullptr;
+        interruptSlot = -1;
+    }
+}
+
+void Sensor::motionInterrupt0()
+{
+    interruptSensors[0]->readMotion();
+}
+
+void Sensor::motionInterrupt1()
+{
+    interruptSensors[1]->readMotion();
+}
+
+// Burst read into the accumulator. Runs in the motion interrupt or with
+// interrupts disabled, so the sensors never share the SPI bus.
+void Sensor::readMotion()
+{
+    byte burst[BURST_Length];
+    adns_read_burst(burst, BURST_Length);
+    accumulate(burst);
 }
 
-vec2f Sensor::integrate()
+void Sensor::poll(Sensor& first, Sensor& second)
 {
-    vec2f delta = {{0.0f, 0.0f}};
-    short deltaX = 0;
-    short deltaY = 0;
+    // Only the gap after each burst is saved, NCS has to stay low through
+    // tSRAD_MOTBR. The readings are close together though.
+    byte bursts[2][BURST_Length];
+    Sensor* sensors[2] = {&first, &second};
+    for(int i = 0; i < 2; i++)
+    {
+        if(sensors[i]->interruptSlot < 0)
+        {
+            spi().queueBurst(sensors[i]->chip, REG_Motion_Burst, bursts[i], BURST_Length);
+        }
+    }
+    spi().run();
+
+    for(int i = 0; i < 2; i++)
+    {
+        if(sensors[i]->interruptSlot < 0)
+        {
+            sensors[i]->accumulate(bursts[i]);
+            sensors[i]->polled = true;
+        }
+    }
+}
 
-    byte motion = adns_read_reg(REG_Motion);
+void Sensor::accumulate(const byte* burst)
+{
+    byte motion = burst[BURST_Motion];
 
     // semantic see datasheet
-    bool motionOccured = motion & 0x80;
-    bool motionFault = motion & 0x40;
-    bool laserValid = motion & 0x20;
+    if((motion & MOTION_Occured) && !(motion & MOTION_Fault) && (motion & MOTION_Laser_Valid))
+    {
+        pendingDelta[0] += int16_t(uint16_t(burst[BURST_Delta_X_H] << 8 | burst[BURST_Delta_X_L]));
+        pendingDelta[1] += int16_t(uint16_t(burst[BURST_Delta_Y_H] << 8 | burst[BURST_Delta_Y_L]));
+    }
 
-    byte SQUAL = adns_read_reg(REG_SQUAL);
-    lifted = (SQUAL < 50);
+    // Faults are kept until integrate() reports them
+    pendingStatus = (pendingStatus & MOTION_Fault) | motion;
+    squal = burst[BURST_SQUAL];
+    shutter = (uint16_t(burst[BURST_Shutter_Upper]) << 8) | burst[BURST_Shutter_Lower];
+    lastRead = micros();
+}
 
-    if(motionOccured && !motionFault && laserValid)
+Increment Sensor::integrate()
+{
+    // Polls the sensor, or only reads it if the motion line is asserted
+    // without an interrupt having been taken or SQUAL is due for a refresh
+    bool interruptDriven = interruptSlot >= 0;
+    if(interruptDriven)
+    {
+        noInterrupts();
+        if(digitalRead(pins[1]) == LOW || micros() - lastRead > MOTION_Refresh_Interval)
+        {
+            readMotion();
+        }
+    }
+    else if(!polled)
     {
-        deltaX = (short) adns_read_reg(REG_Delta_X_L) |
-                    ((short) adns_read_reg(REG_Delta_X_H) << 8);
-        deltaY = (short) adns_read_reg(REG_Delta_Y_L) |
-                    ((short) adns_read_reg(REG_Delta_Y_H) << 8);
+        readMotion();
     }
+    polled = false;
+
+    // Counts beyond int16 saturate, also when flipped
+    int32_t pendingX = pendingDelta[0];
+    int32_t pendingY = pendingDelta[1];
+    short deltaX = (short) (pendingX > 32767 ? 32767 : (pendingX < -32767 ? -32767 : pendingX));
+    short deltaY = (short) (pendingY > 32767 ? 32767 : (pendingY < -32767 ? -32767 : pendingY));
+    byte motion = pendingStatus;
+    pendingDelta[0] = 0;
+    pendingDelta[1] = 0;
+    pendingStatus &= ~MOTION_Fault;
+    lifted = (squal < 50);
+
+    if(interruptDriven)
+    {
+        interrupts();
+    }
+
+    bool motionFault = motion & MOTION_Fault;
+    bool laserValid = motion & MOTION_Laser_Valid;
 
     if(!laserValid)
     {
@@ -194,14 +264,11 @@ vec2f Sensor::integrate()
     integrated[0] += deltaX;
     integrated[1] += deltaY;
 
-    delta[0] = deltaX;
-    delta[1] = deltaY;
-
-    delta[0] *= calib.scale[0];
-    delta[1] *= calib.scale[1];
-
-    delta = mul(correction, delta);
-    return delta;
+#ifdef ITCHY_FIXED_POINT
+    return SimulationFixed::calibrate(fixedCalibration, deltaX, deltaY);
+#else
+    return SimulationCore::calibrate(calib.scale, correction, deltaX, deltaY);
+#endif
 }
 
 vec2f Sensor::absolutePosition()
@@ -220,11 +287,19 @@ void Sensor::reset()
     integrated[1] = 0;
 
     // Delete previous sensor data
-    adns_read_reg(REG_Motion);
-    adns_read_reg(REG_Delta_X_L);
-    adns_read_reg(REG_Delta_X_H);
-    adns_read_reg(REG_Delta_Y_L);
-    adns_read_reg(REG_Delta_Y_H);
+    byte burst[BURST_Length];
+    if(interruptSlot >= 0)
+    {
+        noInterrupts();
+    }
+    adns_read_burst(burst, BURST_Length);
+    pendingDelta[0] = 0;
+    pendingDelta[1] = 0;
+    polled = false;
+    if(interruptSlot >= 0)
+    {
+        interrupts();
+    }
 
     //adns_write_reg(REG_Motion, 0);
 }
@@ -245,6 +320,16 @@ bool Sensor::isLifted() const
     return lifted;
 }
 
+byte Sensor::surfaceQuality() const
+{
+    return squal;
+}
+
+uint16_t Sensor::shutterTime() const
+{
+    return shutter;
+}
+
 void Sensor::setCalibration(const Sensor::CalibrationState& cal)
 {
     calib = cal;
@@ -255,6 +340,7 @@ void Sensor::setCalibration(const Sensor::CalibrationState& cal)
                      calib.alpha[0], calib.alpha[1],
                     -calib.alpha[1],  calib.alpha[0]
                   }};
+    calibrationChanged();
 
     reset();
 }
@@ -282,6 +368,7 @@ void Sensor::calibrationFinishX()
 
     //float dxLen = calibrationTarget[0]/integrated[0];
     calib.scale[0] = dxLen;
+    calibrationChanged();
 
     reset();
 }
@@ -292,10 +379,18 @@ void Sensor::calibrationFinishY()
     float dyLen = correction[0] * calibrationTarget[1]/len(integrated);
     //float dyLen = calibrationTarget[1]/integrated[1];
     calib.scale[1] = dyLen;
+    calibrationChanged();
 
     reset();
 }
 
+void Sensor::calibrationChanged()
+{
+#ifdef ITCHY_FIXED_POINT
+    fixedCalibration = SimulationFixed::calibration(calib.scale, correction);
+#endif
+}
+
 float Sensor::correctionAngle() const
 {
     return correctionAlpha;
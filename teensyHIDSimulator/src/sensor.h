@@ -2,6 +2,24 @@
 #define SENSOR_H
 
 #include "types.h"
+#include "spischeduler.h"
+
+#ifdef ITCHY_FIXED_POINT
+#include "simulationfixed.h"
+using Increment = SimulationFixed::Vector;
+#else
+#include "simulationcore.h"
+using Increment = vec2f;
+#endif
+
+// Bus of the SpiScheduler on the Teensy
+struct TeensySpi
+{
+    uint32_t micros();
+    void wait(uint32_t microseconds);
+    void select(uint8_t pin, bool selected);
+    uint8_t transfer(uint8_t value);
+};
 
 class Sensor
 {
@@ -14,8 +32,20 @@ public:
         vec2f scale;
     };
 
+    // Resets the sensors and uploads their SROM, unless they still have it
+    // after a reset of the MCU only
+    static void boot(Sensor& first, Sensor& second);
+
     void reset();
-    vec2f integrate();
+    // Reads the sensor in its motion interrupt instead of on every
+    // integrate(), which then only takes the accumulated increments. At most
+    // two sensors at a time.
+    void setInterruptDriven(bool enabled);
+    // Reads both polled sensors with their SPI accesses interleaved, the
+    // following integrate() calls use these readings
+    static void poll(Sensor& first, Sensor& second);
+    // Calibrated increment since the last call [m]
+    Increment integrate();
     vec2f absolutePosition();
 
     void calibrationStart();
@@ -26,6 +56,9 @@ public:
     void setCalibrationTarget(vec2f target);
     float correctionAngle() const;
     bool isLifted() const;
+    // SQUAL and shutter time [clock cycles] of the last integrate()
+    byte surfaceQuality() const;
+    uint16_t shutterTime() const;
 
     CalibrationState calibration();
     void setCalibration(const CalibrationState& cal);
@@ -34,17 +67,28 @@ private:
     void adns_com_begin();
     void adns_com_end();
     byte adns_read_reg(byte reg_addr);
+    void adns_read_burst(byte* data, int length);
     void adns_write_reg(byte reg_addr, byte data);
 
 
-    void uploadFirmware();
+    static SpiScheduler<TeensySpi>& spi();
+    void readMotion();
+    void accumulate(const byte* burst);
+    static void motionInterrupt0();
+    static void motionInterrupt1();
+    void calibrationChanged();
 
     std::array<unsigned char, 2> pins;
+    int chip;
+    bool polled;
 
     CalibrationState calib;
 
     mat2f correction;
     float correctionAlpha;
+#ifdef ITCHY_FIXED_POINT
+    SimulationFixed::Calibration fixedCalibration;
+#endif
 
     vec2l integrated;
 
@@ -52,6 +96,15 @@ private:
     bool flipX;
     bool flipY;
     bool lifted;
+    volatile byte squal;
+    volatile uint16_t shutter;
+
+    // Filled by readMotion(), taken by integrate()
+    static Sensor* interruptSensors[2];
+    int interruptSlot;
+    volatile int32_t pendingDelta[2];
+    volatile byte pendingStatus;
+    volatile uint32_t lastRead;
 
     enum class SensorState
     {
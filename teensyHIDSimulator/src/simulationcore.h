@@ -0,0 +1,255 @@
+#ifndef SIMULATIONCORE_H
+#define SIMULATIONCORE_H
+
+// Spring-damper model of the device. Header-only and free of Arduino
+// dependencies, so the very same code runs in the firmware and on the host
+// (see ITCHyBenchmark).
+
+#include "types.h"
+#include "fastmath.h"
+#include <itchy/protocol.h>
+
+namespace SimulationCore
+{
+
+// Geometry of the device [m]
+const float sensorDistance = 0.0756019f;
+
+const vec2f sensorLeftOffset = {
+    {-0.0124523f, 0.0356911f}
+};
+
+const vec2f sensorRightOffset = {
+    {0.0124523f, -0.0356911f}
+};
+
+const float staticAngle = atan2(sensorLeftOffset[1], sensorLeftOffset[0]);
+
+// The orientation is scaled by this factor
+const float angleScale = 0.75f;
+
+// Range of the angle, (maxAngle - 1.5 pi, maxAngle]
+const float maxAngle = angleScale * (FastMath::Pi - staticAngle);
+
+// Steps between rebuilds of the incrementally updated rotation
+const uint8_t rebuildInterval = 16;
+
+// Tangent of the largest turn of the sensors per step applied incrementally,
+// larger ones rebuild the rotation
+const float maxIncrementalTurn = 0.05f;
+
+inline void reset(SimulationState& sim)
+{
+    sim.dt = 0.0;
+    sim.time = 0.0;
+
+    // Set relative positions of sensors:
+    sim.positionLeft = sensorLeftOffset;
+    sim.positionRight = sensorRightOffset;
+
+    sim.rawLeft = sim.positionLeft;
+    sim.rawRight = sim.positionRight;
+
+    sim.velocityLeft = {{0.0, 0.0}};
+    sim.velocityRight = {{0.0, 0.0}};
+
+    sim.position = {{0.0f, 0.0f}};
+    sim.velocity = {{0.0f, 0.0f}};
+    sim.angle = 0.0f;
+    sim.angularVelocity = 0.0f;
+    sim.rotation = {{1.0f, 0.0f, 0.0f, 1.0f}};
+    sim.rotationSteps = 0;
+    sim.direction = {{0.0f, 0.0f}};
+
+    sim.incrementLeft = {{0.0f, 0.0f}};
+    sim.incrementRight = {{0.0f, 0.0f}};
+    sim.incrementTime = 0;
+    sim.rawFlags = ITCHyProtocol::RawReset;
+}
+
+inline void resetRotation(SimulationState& sim)
+{
+    // Set relative positions of sensors:
+    sim.positionLeft[0] = sensorLeftOffset[0] + sim.position[0];
+    sim.positionLeft[1] = sensorLeftOffset[1] + sim.position[1];
+
+    sim.positionRight[0] = sensorRightOffset[0] + sim.position[0];
+    sim.positionRight[1] = sensorRightOffset[1] + sim.position[1];
+
+    sim.rawLeft = sim.positionLeft;
+    sim.rawRight = sim.positionRight;
+
+    // The sensors jump back to the static angle
+    sim.direction = {{0.0f, 0.0f}};
+
+    sim.rawFlags |= ITCHyProtocol::RawLifted;
+}
+
+// Time step of the next step [us]
+inline void advance(SimulationState& sim, uint32_t microseconds)
+{
+    sim.dt = float(microseconds) * 1.0e-6f;
+    sim.time += sim.dt;
+}
+
+// Sensor counts to increments in the frame of the device [m]
+inline vec2f calibrate(const vec2f& scale, const mat2f& correction,
+                       int16_t deltaX, int16_t deltaY)
+{
+    vec2f delta = {{deltaX * scale[0], deltaY * scale[1]}};
+    return mul(correction, delta);
+}
+
+// One step of the spring-damper model, deltaLeftRaw and deltaRightRaw are the
+// sensor increments since the last step [m]
+inline void step(SimulationState& sim, const SimulationParameters& parameters,
+                 const vec2f& deltaLeftRaw, const vec2f& deltaRightRaw)
+{
+    vec2f deltaLeft = mul(sim.rotation, deltaLeftRaw);
+    vec2f deltaRight = mul(sim.rotation, deltaRightRaw);
+
+    sim.rawLeft = add(sim.rawLeft, deltaLeft);
+    sim.rawRight = add(sim.rawRight, deltaRight);
+
+    // Projection onto rigid body
+    vec2f rawCenter = mul(
+                add(sim.rawLeft, sim.rawRight),
+                0.5f);
+
+    vec2f rawDelta = {{
+                          sim.rawLeft[0] - sim.rawRight[0],
+                          sim.rawLeft[1] - sim.rawRight[1]
+                      }};
+
+    // The increments change the length by a fraction of a percent at most,
+    // so Newton iterations from the nominal length replace sqrt
+    float rawLengthInv = FastMath::inverseSqrt(dot(rawDelta, rawDelta), 1.0f/sensorDistance);
+
+    rawDelta = mul(rawDelta, rawLengthInv);
+
+
+    sim.rawLeft = add(rawCenter,
+                           mul(rawDelta, sensorDistance*0.5f));
+
+    sim.rawRight = sub(rawCenter,
+                           mul(rawDelta, sensorDistance*0.5f));
+
+    // Calculate forces
+    vec2f diffLeft  = mul(sub(sim.positionLeft, sim.rawLeft),
+                          parameters.stiffness);
+    vec2f diffRight = mul(sub(sim.positionRight, sim.rawRight),
+                          parameters.stiffness);
+
+    vec2f dampedVLeft = mul(sim.velocityLeft, parameters.damping);
+    vec2f dampedVRight = mul(sim.velocityRight, parameters.damping);
+
+    vec2f accelLeft = mul(add(diffLeft, dampedVLeft), sim.inverseMass);
+    vec2f accelRight = mul(add(diffRight, dampedVRight), sim.inverseMass);
+
+    // Velocity half-step
+    vec2f velHalfLeft = sub(sim.velocityLeft, mul(accelLeft, 0.5 * sim.dt));
+    vec2f velHalfRight = sub(sim.velocityRight, mul(accelRight, 0.5 * sim.dt));
+
+    // Integrate positions
+    sim.positionLeft = add(sim.positionLeft,
+                           mul(velHalfLeft,
+                               sim.dt));
+
+    sim.positionRight = add(sim.positionRight,
+                           mul(velHalfRight,
+                               sim.dt));
+
+    // Calculate forces for t + dt
+    diffLeft  = mul(sub(sim.positionLeft, sim.rawLeft),
+                          parameters.stiffness);
+    diffRight = mul(sub(sim.positionRight, sim.rawRight),
+                          parameters.stiffness);
+
+    dampedVLeft = mul(velHalfLeft, parameters.damping);
+    dampedVRight = mul(velHalfRight, parameters.damping);
+
+    accelLeft = mul(add(diffLeft, dampedVLeft), sim.inverseMass);
+    accelRight = mul(add(diffRight, dampedVRight), sim.inverseMass);
+
+    // Integrate velocity
+    sim.velocityLeft  = sub(velHalfLeft, mul(accelLeft, 0.5 * sim.dt));
+    sim.velocityRight = sub(velHalfRight, mul(accelRight, 0.5 * sim.dt));
+
+
+    // Calculate current rotation
+    vec2f posDelta = {{
+                          sim.positionLeft[0] - sim.positionRight[0],
+                          sim.positionLeft[1] - sim.positionRight[1]
+                      }};
+
+    sim.position = mul(
+                add(sim.positionLeft, sim.positionRight),
+                0.5f);
+
+    float c, s;
+    float t = 0.0f;
+    float alignment = dot(sim.direction, posDelta);
+    if(alignment > 0.0f)
+    {
+        t = cross(sim.direction, posDelta) / alignment;
+    }
+
+    if(++sim.rotationSteps >= rebuildInterval || alignment <= 0.0f ||
+       t > maxIncrementalTurn || t < -maxIncrementalTurn)
+    {
+        // Periodically against the rounding drift of the increments, and
+        // after a reset or lift: rebuild the rotation from the angle
+        sim.rotationSteps = 0;
+        sim.angle = angleScale * (FastMath::atan2(posDelta[1], posDelta[0]) - staticAngle);
+        FastMath::sincos(sim.angle, c, s);
+    }
+    else
+    {
+        // Rotate the unit complex number (cosAlpha, sinAlpha) by the turn
+        // since the last step instead of rebuilding it. t is the tangent of
+        // the turn of posDelta; up to maxIncrementalTurn the truncated series
+        // stay below 1e-7 rad.
+        float turn = angleScale * t * (1.0f - t * t * (1.0f / 3.0f));
+        float turn2 = turn * turn;
+        float cosTurn = 1.0f - 0.5f * turn2;
+        float sinTurn = turn * (1.0f - turn2 * (1.0f / 6.0f));
+
+        float cosAlpha = sim.rotation[0];
+        float sinAlpha = sim.rotation[2];
+        c = cosAlpha * cosTurn - sinAlpha * sinTurn;
+        s = sinAlpha * cosTurn + cosAlpha * sinTurn;
+        sim.angle += turn;
+
+        // Where atan2 of posDelta wraps, the angle jumps by 1.5 pi, which is
+        // an exact multiplication by i or -i
+        if(sim.angle > maxAngle)
+        {
+            float cosine = c;
+            c = -s;
+            s = cosine;
+            sim.angle -= 1.5f * FastMath::Pi;
+        }
+        else if(sim.angle < maxAngle - 1.5f * FastMath::Pi)
+        {
+            float cosine = c;
+            c = s;
+            s = -cosine;
+            sim.angle += 1.5f * FastMath::Pi;
+        }
+    }
+    sim.direction = posDelta;
+
+    sim.rotation = {{
+                       c, -s,
+                       s,  c
+                    }};
+
+    // Apply impulses (assume equal mass everywhere)
+    sim.velocity = add(sim.velocityLeft, sim.velocityRight);
+    sim.angularVelocity = cross({{0.0, sensorDistance*0.5f}}, sim.velocityLeft);
+    sim.angularVelocity += cross({{0.0, -sensorDistance*0.5f}}, sim.velocityRight);
+}
+
+}
+
+#endif // SIMULATIONCORE_H
@@ -0,0 +1,239 @@
+#ifndef SIMULATIONFIXED_H
+#define SIMULATIONFIXED_H
+
+// Fixed point implementation of SimulationCore and of the sensor calibration,
+// selected with ITCHY_FIXED_POINT (see Makefile). Teensy 3.1/3.2 has no FPU,
+// so every float operation is emulated in software. ITCHyBenchmark compares
+// both implementations on the host: fed the same sensor counts for 200 s, the
+// poses deviate from the float ones by up to 1.12 mm and 0.21 mrad (measured),
+// the benchmark fails beyond 1.5 mm and 0.5 mrad.
+//
+// Formats and ranges:
+//   lengths      Q28    +-8 m            3.7 nm
+//   velocities   Q24    +-128 m/s        60 nm/s
+//   forces       Q20    +-2048 N
+//   coefficients Q16    stiffness [N/m], damping [Ns/m], 1/mass [1/kg] up to 32767
+//   time step    Q30    up to 2 s
+//   angles       Q29    [rad]
+//   sine, cosine Q30
+
+#include "fixedpoint.h"
+#include "simulationcore.h"
+
+#include <array>
+
+namespace SimulationFixed
+{
+
+using Length = Fixed<28>;
+using Velocity = Fixed<24>;
+using Force = Fixed<20>;
+using Acceleration = Fixed<16>;
+using Coefficient = Fixed<16>;
+using Time = Fixed<30>;
+using Angle = Fixed<29>;
+using Unit = Fixed<30>;
+
+using Vector = std::array<Length, 2>;
+
+struct Parameters
+{
+    Coefficient stiffness;
+    Coefficient damping;
+    Coefficient inverseMass;
+};
+
+// Index 0 and 1 are the x and y components of the left sensor, 2 and 3 those
+// of the right one
+struct State
+{
+    Length raw[4];
+    Length point[4];
+    Velocity velocity[4];
+
+    Angle angle;
+    Unit cosAngle;
+    Unit sinAngle;
+
+    Time dt;
+    uint64_t time;          // [us]
+};
+
+// Sensor counts to lengths: scale [m/count] in Q40 and the correction
+// rotation
+struct Calibration
+{
+    Fixed<40> scale[2];
+    Unit correction[4];
+};
+
+const Length Offset[4] = {
+    Length::fromFloat(SimulationCore::sensorLeftOffset[0]),
+    Length::fromFloat(SimulationCore::sensorLeftOffset[1]),
+    Length::fromFloat(SimulationCore::sensorRightOffset[0]),
+    Length::fromFloat(SimulationCore::sensorRightOffset[1])
+};
+const Length HalfDistance = Length::fromFloat(0.5f * SimulationCore::sensorDistance);
+const Angle StaticAngle = Angle::fromFloat(SimulationCore::staticAngle);
+
+inline Parameters parameters(const SimulationParameters& parameters)
+{
+    return {
+        Coefficient::fromFloat(parameters.stiffness),
+        Coefficient::fromFloat(parameters.damping),
+        Coefficient::fromFloat(1.0f / parameters.mass)
+    };
+}
+
+inline Calibration calibration(const vec2f& scale, const mat2f& correction)
+{
+    Calibration calibration;
+    calibration.scale[0] = Fixed<40>::fromFloat(scale[0]);
+    calibration.scale[1] = Fixed<40>::fromFloat(scale[1]);
+    for(int i = 0; i < 4; i++)
+    {
+        calibration.correction[i] = Unit::fromFloat(correction[i]);
+    }
+    return calibration;
+}
+
+// Counterpart of SimulationCore::calibrate()
+inline Vector calibrate(const Calibration& calibration, int16_t deltaX, int16_t deltaY)
+{
+    Length x = {int32_t(shift(int64_t(deltaX) * calibration.scale[0].value, 40 - 28))};
+    Length y = {int32_t(shift(int64_t(deltaY) * calibration.scale[1].value, 40 - 28))};
+    return {{
+            mul<28>(calibration.correction[0], x) + mul<28>(calibration.correction[1], y),
+            mul<28>(calibration.correction[2], x) + mul<28>(calibration.correction[3], y)
+        }};
+}
+
+inline vec2f toFloat(const Vector& v)
+{
+    return {{v[0].toFloat(), v[1].toFloat()}};
+}
+
+inline void reset(State& sim)
+{
+    for(int i = 0; i < 4; i++)
+    {
+        sim.point[i] = Offset[i];
+        sim.raw[i] = Offset[i];
+        sim.velocity[i] = {0};
+    }
+
+    sim.angle = {0};
+    sim.cosAngle = {1 << 30};
+    sim.sinAngle = {0};
+    sim.dt = {0};
+    sim.time = 0;
+}
+
+inline void resetRotation(State& sim)
+{
+    Length x = {int32_t((int64_t(sim.point[0].value) + sim.point[2].value) >> 1)};
+    Length y = {int32_t((int64_t(sim.point[1].value) + sim.point[3].value) >> 1)};
+    for(int i = 0; i < 4; i++)
+    {
+        sim.point[i] = Offset[i] + ((i % 2) ? y : x);
+        sim.raw[i] = sim.point[i];
+    }
+}
+
+// Longest time step [us]. The loop may stall for seconds, e.g. while a
+// sensor blinks an error or the configuration is saved. Such gaps would
+// overflow the Q30 time step beyond 2 s and are unstable with the default
+// parameters beyond about 6 ms, so they are simulated as one step of this
+// length.
+const uint32_t MaxTimeStep = 5000;
+
+// Time step of the next step [us]
+inline void advance(State& sim, uint32_t microseconds)
+{
+    uint32_t step = microseconds < MaxTimeStep ? microseconds : MaxTimeStep;
+    sim.dt = {int32_t((int64_t(step) << 30) / 1000000)};
+    sim.time += microseconds;
+}
+
+inline Acceleration acceleration(Length point, Velocity velocity, Length anchor,
+                                 const Parameters& parameters)
+{
+    Force force = mul<20>(parameters.stiffness, point - anchor) +
+                  mul<20>(parameters.damping, velocity);
+    return -mul<16>(force, parameters.inverseMass);
+}
+
+// Counterpart of SimulationCore::step()
+inline void step(State& sim, const Parameters& parameters,
+                 const Vector& deltaLeftRaw, const Vector& deltaRightRaw)
+{
+    // Rotate the increments into the frame of the simulation
+    const Vector* delta[2] = {&deltaLeftRaw, &deltaRightRaw};
+    for(int s = 0; s < 2; s++)
+    {
+        const Vector& d = *delta[s];
+        sim.raw[2*s] += mul<28>(sim.cosAngle, d[0]) - mul<28>(sim.sinAngle, d[1]);
+        sim.raw[2*s + 1] += mul<28>(sim.sinAngle, d[0]) + mul<28>(sim.cosAngle, d[1]);
+    }
+
+    // Projection onto rigid body
+    int32_t deltaX = sim.raw[0].value - sim.raw[2].value;
+    int32_t deltaY = sim.raw[1].value - sim.raw[3].value;
+    uint32_t length = isqrt(uint64_t(int64_t(deltaX) * deltaX + int64_t(deltaY) * deltaY));
+    Unit scale = {int32_t((int64_t(HalfDistance.value) << 30) / length)};
+    Length offsetX = mul<28>(scale, Length{deltaX});
+    Length offsetY = mul<28>(scale, Length{deltaY});
+    Length centerX = {int32_t(shift(int64_t(sim.raw[0].value) + sim.raw[2].value, 1))};
+    Length centerY = {int32_t(shift(int64_t(sim.raw[1].value) + sim.raw[3].value, 1))};
+
+    sim.raw[0] = centerX + offsetX;
+    sim.raw[1] = centerY + offsetY;
+    sim.raw[2] = centerX - offsetX;
+    sim.raw[3] = centerY - offsetY;
+
+    // Velocity Verlet, as the float implementation
+    Time halfDt = {sim.dt.value >> 1};
+    for(int i = 0; i < 4; i++)
+    {
+        Velocity half = sim.velocity[i] +
+                mul<24>(acceleration(sim.point[i], sim.velocity[i], sim.raw[i], parameters), halfDt);
+        sim.point[i] += mul<28>(half, sim.dt);
+        sim.velocity[i] = half +
+                mul<24>(acceleration(sim.point[i], half, sim.raw[i], parameters), halfDt);
+    }
+
+    // Calculate current rotation
+    Angle angle = Cordic::atan2(sim.point[1].value - sim.point[3].value,
+                                sim.point[0].value - sim.point[2].value);
+    // Difference in 64 bits, it leaves the Q29 range before scaling
+    sim.angle = {int32_t(((int64_t(angle.value) - StaticAngle.value) * 3) >> 2)};
+    Cordic::sincos(sim.angle, sim.cosAngle, sim.sinAngle);
+}
+
+// Writes the pose to the float state read for the reports
+inline void publish(const State& fixed, SimulationState& sim)
+{
+    sim.rawLeft = {{fixed.raw[0].toFloat(), fixed.raw[1].toFloat()}};
+    sim.rawRight = {{fixed.raw[2].toFloat(), fixed.raw[3].toFloat()}};
+    sim.positionLeft = {{fixed.point[0].toFloat(), fixed.point[1].toFloat()}};
+    sim.positionRight = {{fixed.point[2].toFloat(), fixed.point[3].toFloat()}};
+    sim.velocityLeft = {{fixed.velocity[0].toFloat(), fixed.velocity[1].toFloat()}};
+    sim.velocityRight = {{fixed.velocity[2].toFloat(), fixed.velocity[3].toFloat()}};
+
+    sim.position = mul(add(sim.positionLeft, sim.positionRight), 0.5f);
+    sim.velocity = add(sim.velocityLeft, sim.velocityRight);
+    sim.angle = fixed.angle.toFloat();
+    sim.angularVelocity = 0.5f * SimulationCore::sensorDistance *
+                          (sim.velocityRight[0] - sim.velocityLeft[0]);
+
+    float c = fixed.cosAngle.toFloat();
+    float s = fixed.sinAngle.toFloat();
+    sim.rotation = {{c, -s, s, c}};
+
+    sim.dt = fixed.dt.toFloat();
+    sim.time = float(fixed.time) * 1.0e-6f;
+}
+
+}
+
+#endif // SIMULATIONFIXED_H
@@ -0,0 +1,278 @@
+#ifndef SPISCHEDULER_H
+#define SPISCHEDULER_H
+
+// Register accesses to several ADNS-9800 sharing one SPI bus. The datasheet
+// requires NCS to stay low from the address through tSRAD, so these waits
+// remain busy waits. The gaps a chip needs after NCS is raised (tSWW/tSWR
+// after writes, tSRW/tSRR after reads, tBEXIT after bursts) are kept as
+// per-chip deadlines instead: run() spends them on the queued accesses of
+// the other chips, and immediate accesses only wait for a deadline that has
+// not passed yet.
+// Header-only and free of Arduino dependencies. Bus provides micros(),
+// wait(us), select(pin, selected) and transfer(byte), see sensor.cpp and the
+// timing stand-in in ITCHyBenchmark.
+
+#include <cstdint>
+
+namespace SpiTiming
+{
+
+// [us]
+const uint32_t ReadAddress = 100;       // tSRAD
+const uint32_t BurstAddress = 35;       // tSRAD_MOTBR
+const uint32_t ReadHold = 1;            // tSCLK-NCS after reads
+const uint32_t WriteHold = 20;          // tSCLK-NCS after writes
+const uint32_t AfterRead = 19;          // tSRW/tSRR, counted from NCS high
+const uint32_t AfterWrite = 100;        // tSWW/tSWR, counted from NCS high
+const uint32_t AfterBurst = 1;          // tBEXIT
+
+}
+
+template<typename Bus, int MaxChips = 2, int Capacity = 16>
+class SpiScheduler
+{
+public:
+    static const int MaxChipCount = MaxChips;
+
+    explicit SpiScheduler(Bus& bus) :
+        bus(bus),
+        chipCount(0)
+    {
+    }
+
+    // Chip select pin of a new chip, -1 if all slots are taken
+    int addChip(uint8_t select)
+    {
+        if(chipCount == MaxChips)
+        {
+            return -1;
+        }
+
+        Chip& chip = chips[chipCount];
+        chip.select = select;
+        chip.readyAt = bus.micros();
+        chip.head = 0;
+        chip.count = 0;
+        bus.select(select, false);
+        return chipCount++;
+    }
+
+    // Waits for the deadline of the chip and selects it
+    void begin(int chip)
+    {
+        waitFor(chip);
+        bus.select(chips[chip].select, true);
+    }
+
+    // Deselects the chip, which is ready again after gap [us]. One more
+    // microsecond makes up for the truncated clock.
+    void end(int chip, uint32_t gap)
+    {
+        bus.select(chips[chip].select, false);
+        chips[chip].readyAt = bus.micros() + gap + 1;
+    }
+
+    uint8_t transfer(uint8_t value)
+    {
+        return bus.transfer(value);
+    }
+
+    uint8_t read(int chip, uint8_t address)
+    {
+        begin(chip);
+        bus.transfer(address & 0x7f);
+        bus.wait(SpiTiming::ReadAddress);
+        uint8_t value = bus.transfer(0);
+        bus.wait(SpiTiming::ReadHold);
+        end(chip, SpiTiming::AfterRead);
+        return value;
+    }
+
+    void write(int chip, uint8_t address, uint8_t value)
+    {
+        begin(chip);
+        bus.transfer(address | 0x80);
+        bus.transfer(value);
+        bus.wait(SpiTiming::WriteHold);
+        end(chip, SpiTiming::AfterWrite);
+    }
+
+    void burst(int chip, uint8_t address, uint8_t* data, int length)
+    {
+        begin(chip);
+        bus.transfer(address & 0x7f);
+        bus.wait(SpiTiming::BurstAddress);
+        for(int i = 0; i < length; i++)
+        {
+            data[i] = bus.transfer(0);
+        }
+        end(chip, SpiTiming::AfterBurst);
+    }
+
+    // Write-only burst of source(0) to source(length - 1), byteDelay [us]
+    // apart, to count chips at once. They all share MOSI, but also drive
+    // MISO while selected, so more than one chip only on hardware that
+    // tolerates it.
+    template<typename Source>
+    void upload(const int* chip, int count, uint8_t address, Source source, int length,
+                uint32_t byteDelay)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            waitFor(chip[i]);
+        }
+        for(int i = 0; i < count; i++)
+        {
+            bus.select(chips[chip[i]].select, true);
+        }
+
+        bus.transfer(address | 0x80);
+        bus.wait(byteDelay);
+        for(int n = 0; n < length; n++)
+        {
+            bus.transfer(source(n));
+            bus.wait(byteDelay);
+        }
+
+        for(int i = 0; i < count; i++)
+        {
+            end(chip[i], SpiTiming::AfterBurst);
+        }
+    }
+
+    // Moves the deadline of the chip, e.g. to let it boot
+    void delay(int chip, uint32_t microseconds)
+    {
+        Chip& c = chips[chip];
+        uint32_t now = bus.micros();
+        c.readyAt = (int32_t(c.readyAt - now) > 0 ? c.readyAt : now) + microseconds;
+    }
+
+    // Queued accesses run in order per chip by run(), false if the queue of
+    // the chip is full. result and data must stay valid until then.
+    bool queueRead(int chip, uint8_t address, uint8_t* result)
+    {
+        return queue(chip, {Operation::Read, address, 0, result, 1});
+    }
+
+    bool queueWrite(int chip, uint8_t address, uint8_t value)
+    {
+        return queue(chip, {Operation::Write, address, value, nullptr, 0});
+    }
+
+    bool queueBurst(int chip, uint8_t address, uint8_t* data, int length)
+    {
+        return queue(chip, {Operation::Burst, address, 0, data, length});
+    }
+
+    bool queueDelay(int chip, uint32_t microseconds)
+    {
+        return queue(chip, {Operation::Delay, 0, 0, nullptr, int(microseconds)});
+    }
+
+    // Runs the queued accesses, always continuing with the chip that is
+    // ready first
+    void run()
+    {
+        while(true)
+        {
+            int next = -1;
+            for(int i = 0; i < chipCount; i++)
+            {
+                if(chips[i].count > 0 &&
+                   (next < 0 || int32_t(chips[i].readyAt - chips[next].readyAt) < 0))
+                {
+                    next = i;
+                }
+            }
+
+            if(next < 0)
+            {
+                return;
+            }
+
+            Chip& chip = chips[next];
+            Operation operation = chip.operations[chip.head];
+            chip.head = (chip.head + 1) % Capacity;
+            chip.count--;
+
+            switch(operation.type)
+            {
+            case Operation::Read:
+                *operation.data = read(next, operation.address);
+                break;
+            case Operation::Write:
+                write(next, operation.address, operation.value);
+                break;
+            case Operation::Burst:
+                burst(next, operation.address, operation.data, operation.length);
+                break;
+            case Operation::Delay:
+                delay(next, uint32_t(operation.length));
+                break;
+            }
+        }
+    }
+
+    // Waits until no deadline is pending
+    void finish()
+    {
+        for(int i = 0; i < chipCount; i++)
+        {
+            waitFor(i);
+        }
+    }
+
+private:
+    struct Operation
+    {
+        enum Type
+        {
+            Read,
+            Write,
+            Burst,
+            Delay
+        } type;
+
+        uint8_t address;
+        uint8_t value;
+        uint8_t* data;
+        int length;
+    };
+
+    struct Chip
+    {
+        uint8_t select;
+        uint32_t readyAt;
+        Operation operations[Capacity];
+        int head;
+        int count;
+    };
+
+    bool queue(int chip, const Operation& operation)
+    {
+        Chip& c = chips[chip];
+        if(c.count == Capacity)
+        {
+            return false;
+        }
+        c.operations[(c.head + c.count) % Capacity] = operation;
+        c.count++;
+        return true;
+    }
+
+    void waitFor(int chip)
+    {
+        int32_t remaining = int32_t(chips[chip].readyAt - bus.micros());
+        if(remaining > 0)
+        {
+            bus.wait(uint32_t(remaining));
+        }
+    }
+
+    Bus& bus;
+    Chip chips[MaxChips];
+    int chipCount;
+};
+
+#endif // SPISCHEDULER_H
@@ -2,6 +2,7 @@
 #define TYPES_H
 
 #include <array>
+#include <cstdint>
 #include <functional>
 #include <cmath>
 
@@ -109,6 +110,15 @@ struct SimulationState
     float torque = 0.0;
 
     mat2f rotation = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    uint8_t rotationSteps = 0;      // Since the last rebuild
+    vec2f direction = {{0.0f, 0.0f}};   // Right to left sensor of the last step
+
+    // Raw increment reports: sensor increments since the last report [m],
+    // the time they cover [us] and ITCHyProtocol::RawFlag bits
+    vec2f incrementLeft = {{0.0f, 0.0f}};
+    vec2f incrementRight = {{0.0f, 0.0f}};
+    uint32_t incrementTime = 0;
+    byte rawFlags = 0;
 };
 
 #endif // TYPES_H
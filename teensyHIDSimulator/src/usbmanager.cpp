@@ -20,8 +20,11 @@ USBManager::USBManager()
 
 }
 
-void USBManager::sendFrame(const USBPackage &package)
+void USBManager::sendFrame(USBPackage &package, ITCHyProtocol::ReportFormat format)
 {
+    // Frames that are not sent count as lost on the host side as well
+    ITCHyProtocol::seal(package.raw, sequence++, format);
+
     int ret = RawHID.send(package.raw, 2);
     if(ret < 0) // USB Error
     {
@@ -46,16 +49,16 @@ void USBManager::checkIncoming()
     if(ret > 0) // Parse command
     {
         int p = 0;
-        char mode = Invalid;
+        char mode = ITCHyProtocol::Invalid;
         p += bufferToType(buffer, mode, p);
 
         switch(mode)
         {
-        case Invalid:
+        case ITCHyProtocol::Invalid:
             // Ignore
             break;
 
-        case CalibrationData:
+        case ITCHyProtocol::CalibrationData:
         {
             vec2f calibrationTarget;
             p += bufferToType(buffer, calibrationTarget[0], p, 2);
@@ -63,7 +66,7 @@ void USBManager::checkIncoming()
             break;
         }
 
-        case SimulationData:
+        case ITCHyProtocol::SimulationData:
         {
             SimulationParameters params;
             p += bufferToType(buffer, params.damping, p);
@@ -74,7 +77,7 @@ void USBManager::checkIncoming()
             break;
         }
 
-        case SetColor:
+        case ITCHyProtocol::SetColor:
         {
             color cl;
             p += bufferToType(buffer, cl[0], p, 3);
@@ -82,13 +85,29 @@ void USBManager::checkIncoming()
             break;
         }
 
-        case SaveConfig:
+        case ITCHyProtocol::SaveConfig:
             saveConfiguration();
             break;
 
-        case Calibrate:
+        case ITCHyProtocol::Calibrate:
             calibrate();
             break;
+
+        case ITCHyProtocol::SetReportFormat:
+        {
+            char format = ITCHyProtocol::Snapshot;
+            p += bufferToType(buffer, format, p);
+            if(format == ITCHyProtocol::MultiSample ||
+               format == ITCHyProtocol::RawIncrements)
+            {
+                reportFormat(ITCHyProtocol::ReportFormat(format));
+            }
+            else
+            {
+                reportFormat(ITCHyProtocol::Snapshot);
+            }
+            break;
+        }
         }
     }
 }
@@ -127,3 +146,8 @@ std::function<void(SimulationParameters)>& USBManager::onParameters()
 {
     return parameters;
 }
+
+std::function<void(ITCHyProtocol::ReportFormat)>& USBManager::onReportFormat()
+{
+    return reportFormat;
+}
@@ -2,6 +2,7 @@
 #define USBMANAGER_H
 
 #include "types.h"
+#include <itchy/protocol.h>
 
 union USBPackage
 {
@@ -13,6 +14,11 @@ union USBPackage
         float angularVelocity;
         byte  button;
 
+        // Integrity (3 bytes, see protocol.h)
+        byte sequence;          // Frame counter, wraps around
+        byte version;           // Protocol version, 0 for old firmware
+        byte checksum;          // CRC-8 of the report
+
         // Raw sensor data (16 bytes)
         vec2f leftSensor;
         vec2f rightSensor;
@@ -25,29 +31,24 @@ union USBPackage
         float timeStep;
         float time;
 
-        // Unused
-        byte unused[7];
+        // Device clock (4 bytes)
+        uint32_t deviceTime;    // Microseconds since device start when sampled
     } data;
 
-    char raw[64];
+    char raw[ITCHyProtocol::ReportSize];
 };
 
-enum USBOpCodes
-{
-    Invalid = 0,
-    CalibrationData = 1,
-    SimulationData = 2,
-    SetColor = 3,
-    SaveConfig = 4,
-    Calibrate = 5
-};
+ITCHY_CHECK_REPORT_LAYOUT(USBPackage::Data);
+static_assert(sizeof(USBPackage) == ITCHyProtocol::ReportSize, "USBPackage");
 
 class USBManager
 {
 public:
     USBManager();
 
-    void sendFrame(const USBPackage& package);
+    // Numbers and seals the frame before sending
+    void sendFrame(USBPackage& package,
+                   ITCHyProtocol::ReportFormat format = ITCHyProtocol::Snapshot);
     void checkIncoming();
 
     std::function<void()>& onTimeOut();
@@ -58,8 +59,11 @@ public:
     std::function<void(vec2f)>& onCalibrationData();
     std::function<void(color)>& onLEDColor();
     std::function<void(SimulationParameters)>& onParameters();
+    std::function<void(ITCHyProtocol::ReportFormat)>& onReportFormat();
 
 private:
+    uint8_t sequence = 0;
+
     std::function<void()> timeOut;
     std::function<void()> USBError;
     std::function<void()> saveConfiguration;
@@ -67,6 +71,7 @@ private:
     std::function<void(vec2f)> calibrationData;
     std::function<void(color)> LEDColor;
     std::function<void(SimulationParameters)> parameters;
+    std::function<void(ITCHyProtocol::ReportFormat)> reportFormat;
 };
 
 #endif // USBMANAGER_H